@@ -0,0 +1,501 @@
+/*******************************************************************
+*   LATCHDetector.h
+*   LATCH
+*
+*	Author: Kareem Omar
+*	kareem.omar@uah.edu
+*	https://github.com/komrad36
+*
+*******************************************************************/
+//
+// Built-in keypoint detector, so LATCH needs no OpenCV to find what
+// it describes: FAST-9 corners, non-max suppressed on their FAST score
+// and ranked by Harris response, oriented by intensity centroid, as
+// ORB does on one pyramid level. Keypoints come out in LATCH's own
+// KeyPoint format, with the angle in radians.
+//
+// FAST is tested 32 (AVX2) or 16 (SSE4.1) pixels at a time: the 16
+// circle pixels are compared with saturating differences, a compass
+// test on pixels 0, 4, 8 and 12 rejects most vectors, and the 9-pixel
+// arc is found by OR-ing runs of 2, 4, 8 and 9 "not brighter" / "not
+// darker" masks. The choice follows LATCHActiveKernel().
+//
+// The image is processed in bands of band_rows() rows. Each band is
+// detected on its own (plus one row either side for non-max
+// suppression) and keeps its share of max_keypoints(), so keypoints
+// are spread over the image and bands are independent. Bands are split
+// into one contiguous stripe per pool thread. detect_and_describe()
+// describes a band once detection has run LATCH_TILE_HALO rows past
+// it, while the rows its patches read are still in cache, instead of
+// making a second pass over the image.
+//
+
+#pragma once
+
+#include "LATCH.h"
+
+// Bresenham circle of radius 3, clockwise from below the center: { dx, dy }
+constexpr int LATCH_FAST_CIRCLE[16][2] = { { 0, 3 }, { 1, 3 }, { 2, 2 }, { 3, 1 }, { 3, 0 }, { 3, -1 }, { 2, -2 }, { 1, -3 }, { 0, -3 }, { -1, -3 }, { -2, -2 }, { -3, -1 }, { -3, 0 }, { -3, 1 }, { -2, 2 }, { -1, 3 } };
+
+// radius of the intensity-centroid patch, ORB's HALF_PATCH_SIZE
+constexpr int LATCH_ORIENT_RADIUS = 15;
+
+// closest keypoints may come to the border: the orientation patch reads columns x - 15 to x + 16
+constexpr int LATCH_DETECT_MIN_EDGE = LATCH_ORIENT_RADIUS + 1;
+
+// Whether the circular 16-bit mask m has 9 contiguous set bits
+inline bool _LATCHArc9(uint32_t m) {
+	m |= m << 16;
+	// bit i of a: bits i to i + 1, then i + 3, then i + 7 of m set
+	uint32_t a = m & (m >> 1);
+	a &= a >> 2;
+	a &= a >> 4;
+	return ((a & (m >> 8)) & 0xFFFF) != 0;
+}
+
+// FAST-9: 9 contiguous circle pixels all brighter than *p + t or all darker than *p - t
+inline bool _LATCHFast(const uint8_t* const p, const int stride, const int t) {
+	const int c = *p;
+	uint32_t bright = 0, dark = 0;
+	for (int k = 0; k < 16; ++k) {
+		const int v = p[LATCH_FAST_CIRCLE[k][1] * stride + LATCH_FAST_CIRCLE[k][0]];
+		bright |= static_cast<uint32_t>(v > c + t) << k;
+		dark |= static_cast<uint32_t>(v < c - t) << k;
+	}
+	return _LATCHArc9(bright) || _LATCHArc9(dark);
+}
+
+// Corner strength for non-max suppression: the larger of the summed excesses of the circle
+// pixels brighter than *p + t and of those darker than *p - t
+inline int _LATCHFastScore(const uint8_t* const p, const int stride, const int t) {
+	const int c = *p;
+	int bright = 0, dark = 0;
+	for (int k = 0; k < 16; ++k) {
+		const int v = p[LATCH_FAST_CIRCLE[k][1] * stride + LATCH_FAST_CIRCLE[k][0]];
+		bright += std::max(0, v - c - t);
+		dark += std::max(0, c - t - v);
+	}
+	return std::max(bright, dark);
+}
+
+// Writes the _LATCHFastScore() of each FAST-9 corner of 'row' in [x0, x1) to scores[x], and 0 for
+// the other pixels there. Needs x1 - x0 >= 32.
+LATCH_TARGET("avx2") inline void _LATCHFastRowAVX2(const uint8_t* const row, const int stride, const int x0, const int x1, const int t, uint16_t* const scores) {
+	int off[16];
+	for (int k = 0; k < 16; ++k) off[k] = LATCH_FAST_CIRCLE[k][1] * stride + LATCH_FAST_CIRCLE[k][0];
+	const __m256i vt = _mm256_set1_epi8(static_cast<char>(t)), zero = _mm256_setzero_si256(), ones = _mm256_set1_epi8(-1);
+	for (int x = x0; x < x1; x += 32) {
+		// the last vector is moved back to end at x1, rewriting some scores with the same values
+		const int at = std::min(x, x1 - 32);
+		const uint8_t* const p = row + at;
+		__m256i* const out = reinterpret_cast<__m256i*>(scores + at);
+		const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+		const __m256i hi = _mm256_adds_epu8(c, vt), lo = _mm256_subs_epu8(c, vt);
+		__m256i nb[16], nd[16];
+		for (int k = 0; k < 16; k += 4) {
+			const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + off[k]));
+			nb[k] = _mm256_cmpeq_epi8(_mm256_subs_epu8(v, hi), zero);
+			nd[k] = _mm256_cmpeq_epi8(_mm256_subs_epu8(lo, v), zero);
+		}
+		// any 9-arc covers two adjacent compass pixels
+		const __m256i rb = _mm256_and_si256(_mm256_and_si256(_mm256_or_si256(nb[0], nb[4]), _mm256_or_si256(nb[4], nb[8])), _mm256_and_si256(_mm256_or_si256(nb[8], nb[12]), _mm256_or_si256(nb[12], nb[0])));
+		const __m256i rd = _mm256_and_si256(_mm256_and_si256(_mm256_or_si256(nd[0], nd[4]), _mm256_or_si256(nd[4], nd[8])), _mm256_and_si256(_mm256_or_si256(nd[8], nd[12]), _mm256_or_si256(nd[12], nd[0])));
+		if (_mm256_testc_si256(_mm256_and_si256(rb, rd), ones)) {
+			_mm256_storeu_si256(out, zero);
+			_mm256_storeu_si256(out + 1, zero);
+			continue;
+		}
+		for (int k = 0; k < 16; ++k) {
+			if (!(k & 3)) continue;
+			const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + off[k]));
+			nb[k] = _mm256_cmpeq_epi8(_mm256_subs_epu8(v, hi), zero);
+			nd[k] = _mm256_cmpeq_epi8(_mm256_subs_epu8(lo, v), zero);
+		}
+		// a lane with no all-bright or all-dark arc has every arc's OR of "not" masks set
+		__m256i none = ones;
+		for (__m256i* m : { nb, nd }) {
+			__m256i o2[16], o4[16];
+			for (int k = 0; k < 16; ++k) o2[k] = _mm256_or_si256(m[k], m[(k + 1) & 15]);
+			for (int k = 0; k < 16; ++k) o4[k] = _mm256_or_si256(o2[k], o2[(k + 2) & 15]);
+			for (int k = 0; k < 16; ++k) none = _mm256_and_si256(none, _mm256_or_si256(_mm256_or_si256(o4[k], o4[(k + 4) & 15]), m[(k + 8) & 15]));
+		}
+		if (_mm256_testc_si256(none, ones)) {
+			_mm256_storeu_si256(out, zero);
+			_mm256_storeu_si256(out + 1, zero);
+			continue;
+		}
+		// scores summed in 16 bits, columns at + [0, 16) and at + [16, 32)
+		__m256i sb[2] = { zero, zero }, sd[2] = { zero, zero };
+		for (int k = 0; k < 16; ++k) {
+			const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + off[k]));
+			const __m256i eb = _mm256_subs_epu8(v, hi), ed = _mm256_subs_epu8(lo, v);
+			sb[0] = _mm256_add_epi16(sb[0], _mm256_cvtepu8_epi16(_mm256_castsi256_si128(eb)));
+			sb[1] = _mm256_add_epi16(sb[1], _mm256_cvtepu8_epi16(_mm256_extracti128_si256(eb, 1)));
+			sd[0] = _mm256_add_epi16(sd[0], _mm256_cvtepu8_epi16(_mm256_castsi256_si128(ed)));
+			sd[1] = _mm256_add_epi16(sd[1], _mm256_cvtepu8_epi16(_mm256_extracti128_si256(ed, 1)));
+		}
+		const __m256i corner = _mm256_xor_si256(none, ones);
+		_mm256_storeu_si256(out, _mm256_and_si256(_mm256_max_epu16(sb[0], sd[0]), _mm256_cvtepi8_epi16(_mm256_castsi256_si128(corner))));
+		_mm256_storeu_si256(out + 1, _mm256_and_si256(_mm256_max_epu16(sb[1], sd[1]), _mm256_cvtepi8_epi16(_mm256_extracti128_si256(corner, 1))));
+	}
+}
+
+// As above, 16 pixels at a time. Needs x1 - x0 >= 16.
+LATCH_TARGET("sse4.1") inline void _LATCHFastRowSSE41(const uint8_t* const row, const int stride, const int x0, const int x1, const int t, uint16_t* const scores) {
+	int off[16];
+	for (int k = 0; k < 16; ++k) off[k] = LATCH_FAST_CIRCLE[k][1] * stride + LATCH_FAST_CIRCLE[k][0];
+	const __m128i vt = _mm_set1_epi8(static_cast<char>(t)), zero = _mm_setzero_si128(), ones = _mm_set1_epi8(-1);
+	for (int x = x0; x < x1; x += 16) {
+		const int at = std::min(x, x1 - 16);
+		const uint8_t* const p = row + at;
+		__m128i* const out = reinterpret_cast<__m128i*>(scores + at);
+		const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		const __m128i hi = _mm_adds_epu8(c, vt), lo = _mm_subs_epu8(c, vt);
+		__m128i nb[16], nd[16];
+		for (int k = 0; k < 16; k += 4) {
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + off[k]));
+			nb[k] = _mm_cmpeq_epi8(_mm_subs_epu8(v, hi), zero);
+			nd[k] = _mm_cmpeq_epi8(_mm_subs_epu8(lo, v), zero);
+		}
+		const __m128i rb = _mm_and_si128(_mm_and_si128(_mm_or_si128(nb[0], nb[4]), _mm_or_si128(nb[4], nb[8])), _mm_and_si128(_mm_or_si128(nb[8], nb[12]), _mm_or_si128(nb[12], nb[0])));
+		const __m128i rd = _mm_and_si128(_mm_and_si128(_mm_or_si128(nd[0], nd[4]), _mm_or_si128(nd[4], nd[8])), _mm_and_si128(_mm_or_si128(nd[8], nd[12]), _mm_or_si128(nd[12], nd[0])));
+		if (_mm_testc_si128(_mm_and_si128(rb, rd), ones)) {
+			_mm_storeu_si128(out, zero);
+			_mm_storeu_si128(out + 1, zero);
+			continue;
+		}
+		for (int k = 0; k < 16; ++k) {
+			if (!(k & 3)) continue;
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + off[k]));
+			nb[k] = _mm_cmpeq_epi8(_mm_subs_epu8(v, hi), zero);
+			nd[k] = _mm_cmpeq_epi8(_mm_subs_epu8(lo, v), zero);
+		}
+		__m128i none = ones;
+		for (__m128i* m : { nb, nd }) {
+			__m128i o2[16], o4[16];
+			for (int k = 0; k < 16; ++k) o2[k] = _mm_or_si128(m[k], m[(k + 1) & 15]);
+			for (int k = 0; k < 16; ++k) o4[k] = _mm_or_si128(o2[k], o2[(k + 2) & 15]);
+			for (int k = 0; k < 16; ++k) none = _mm_and_si128(none, _mm_or_si128(_mm_or_si128(o4[k], o4[(k + 4) & 15]), m[(k + 8) & 15]));
+		}
+		if (_mm_testc_si128(none, ones)) {
+			_mm_storeu_si128(out, zero);
+			_mm_storeu_si128(out + 1, zero);
+			continue;
+		}
+		__m128i sb[2] = { zero, zero }, sd[2] = { zero, zero };
+		for (int k = 0; k < 16; ++k) {
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + off[k]));
+			const __m128i eb = _mm_subs_epu8(v, hi), ed = _mm_subs_epu8(lo, v);
+			sb[0] = _mm_add_epi16(sb[0], _mm_cvtepu8_epi16(eb));
+			sb[1] = _mm_add_epi16(sb[1], _mm_cvtepu8_epi16(_mm_srli_si128(eb, 8)));
+			sd[0] = _mm_add_epi16(sd[0], _mm_cvtepu8_epi16(ed));
+			sd[1] = _mm_add_epi16(sd[1], _mm_cvtepu8_epi16(_mm_srli_si128(ed, 8)));
+		}
+		const __m128i corner = _mm_xor_si128(none, ones);
+		_mm_storeu_si128(out, _mm_and_si128(_mm_max_epu16(sb[0], sd[0]), _mm_cvtepi8_epi16(corner)));
+		_mm_storeu_si128(out + 1, _mm_and_si128(_mm_max_epu16(sb[1], sd[1]), _mm_cvtepi8_epi16(_mm_srli_si128(corner, 8))));
+	}
+}
+
+// Appends the x in [x0, x1) whose score in 'mid' exceeds those of its 8 neighbors in the rows
+// above, mid and below, which hold zeros from x0 - 1 to x1 + 8
+LATCH_TARGET("sse4.1") inline void _LATCHPeaks(const uint16_t* const above, const uint16_t* const mid, const uint16_t* const below, const int x0, const int x1, std::vector<int>& xs) {
+	for (int x = x0; x < x1; x += 8) {
+		const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mid + x));
+		if (_mm_testz_si128(c, c)) continue;
+		// scores are at most 16 * 255, so signed compares do
+		__m128i m = _mm_and_si128(_mm_cmpgt_epi16(c, _mm_loadu_si128(reinterpret_cast<const __m128i*>(mid + x - 1))), _mm_cmpgt_epi16(c, _mm_loadu_si128(reinterpret_cast<const __m128i*>(mid + x + 1))));
+		for (const uint16_t* const r : { above, below }) {
+			m = _mm_and_si128(m, _mm_cmpgt_epi16(c, _mm_loadu_si128(reinterpret_cast<const __m128i*>(r + x - 1))));
+			m = _mm_and_si128(m, _mm_cmpgt_epi16(c, _mm_loadu_si128(reinterpret_cast<const __m128i*>(r + x))));
+			m = _mm_and_si128(m, _mm_cmpgt_epi16(c, _mm_loadu_si128(reinterpret_cast<const __m128i*>(r + x + 1))));
+		}
+		for (uint32_t peaks = static_cast<uint32_t>(_mm_movemask_epi8(_mm_packs_epi16(m, _mm_setzero_si128()))); peaks; peaks &= peaks - 1) xs.push_back(x + static_cast<int>(_LATCHCtz(peaks)));
+	}
+}
+
+// Harris response (k = 0.04) of the 3x3 Sobel gradients over the 7x7 block around p, scaled as
+// ORB scales it
+inline float _LATCHHarris(const uint8_t* const p, const int stride) {
+	int a = 0, b = 0, c = 0;
+	for (int dy = -3; dy <= 3; ++dy) {
+		for (int dx = -3; dx <= 3; ++dx) {
+			const uint8_t* const q = p + dy * stride + dx;
+			const int ix = (q[1] - q[-1]) * 2 + (q[1 - stride] - q[-1 - stride]) + (q[1 + stride] - q[-1 + stride]);
+			const int iy = (q[stride] - q[-stride]) * 2 + (q[stride - 1] - q[-stride - 1]) + (q[stride + 1] - q[-stride + 1]);
+			a += ix * ix;
+			b += iy * iy;
+			c += ix * iy;
+		}
+	}
+	constexpr double scale = 1.0 / (4 * 7 * 255.0);
+	const double fa = a, fb = b, fc = c;
+	return static_cast<float>((fa * fb - fc * fc - 0.04 * (fa + fb) * (fa + fb)) * (scale * scale * scale * scale));
+}
+
+// _LATCHHarris() with the block's 7 columns in 16-bit lanes: per row, horizontal differences and
+// [1 2 1] sums of 3 loads, combined vertically into the Sobel gradients, squared by pmaddwd
+LATCH_TARGET("sse4.1") inline float _LATCHHarrisSSE41(const uint8_t* const p, const int stride) {
+	__m128i d[9], s[9];
+	for (int r = 0; r < 9; ++r) {
+		const uint8_t* const q = p + (r - 4) * stride;
+		const __m128i left = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(q - 4)));
+		const __m128i mid = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(q - 3)));
+		const __m128i right = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(q - 2)));
+		d[r] = _mm_sub_epi16(right, left);
+		s[r] = _mm_add_epi16(_mm_add_epi16(left, right), _mm_add_epi16(mid, mid));
+	}
+	// lane 7 is column x + 4, outside the block
+	const __m128i keep = _mm_setr_epi16(-1, -1, -1, -1, -1, -1, -1, 0);
+	__m128i a = _mm_setzero_si128(), b = a, c = a;
+	for (int r = 1; r < 8; ++r) {
+		const __m128i ix = _mm_and_si128(_mm_add_epi16(_mm_add_epi16(d[r - 1], d[r + 1]), _mm_add_epi16(d[r], d[r])), keep);
+		const __m128i iy = _mm_and_si128(_mm_sub_epi16(s[r + 1], s[r - 1]), keep);
+		a = _mm_add_epi32(a, _mm_madd_epi16(ix, ix));
+		b = _mm_add_epi32(b, _mm_madd_epi16(iy, iy));
+		c = _mm_add_epi32(c, _mm_madd_epi16(ix, iy));
+	}
+	// horizontal sums: a and b in lanes 0 and 1 of ab, c in lane 0 of cc
+	const __m128i ab = _mm_hadd_epi32(_mm_hadd_epi32(a, b), _mm_setzero_si128()), cc = _mm_hadd_epi32(_mm_hadd_epi32(c, c), c);
+	constexpr double scale = 1.0 / (4 * 7 * 255.0);
+	const double fa = _mm_cvtsi128_si32(ab), fb = _mm_extract_epi32(ab, 1), fc = _mm_cvtsi128_si32(cc);
+	return static_cast<float>((fa * fb - fc * fc - 0.04 * (fa + fb) * (fa + fb)) * (scale * scale * scale * scale));
+}
+
+// ORB's circular orientation patch: half-width umax[|v|] on row v, made symmetric under
+// swapping u and v, and per half-width the byte masks of columns [-15, 0] and [1, 16] within it
+struct _LatchOrientPatch {
+	int umax[LATCH_ORIENT_RADIUS + 2];
+	alignas(16) uint8_t mask[LATCH_ORIENT_RADIUS + 1][32];
+
+	_LatchOrientPatch() {
+		constexpr int r = LATCH_ORIENT_RADIUS;
+		const int vmax = static_cast<int>(std::floor(r * std::sqrt(2.0) / 2 + 1)), vmin = static_cast<int>(std::ceil(r * std::sqrt(2.0) / 2));
+		for (int v = 0; v <= vmax; ++v) umax[v] = static_cast<int>(std::lround(std::sqrt(static_cast<double>(r * r - v * v))));
+		for (int v = r, v0 = 0; v >= vmin; --v) {
+			while (umax[v0] == umax[v0 + 1]) ++v0;
+			umax[v] = v0++;
+		}
+		for (int v = 0; v <= r; ++v) {
+			for (int i = 0; i < 32; ++i) mask[v][i] = std::abs(i - r) <= umax[v] ? 0xFF : 0;
+		}
+	}
+};
+
+inline const _LatchOrientPatch& _LATCHOrientPatch() {
+	static const _LatchOrientPatch patch;
+	return patch;
+}
+
+// Angle in radians of the intensity centroid of the circular patch around p, atan2(m01, m10)
+// as in ORB. Per row, maddubs weighs the pixels by their column and psadbw sums them.
+LATCH_TARGET("sse4.1") inline float _LATCHOrientation(const uint8_t* const p, const int stride) {
+	const _LatchOrientPatch& patch = _LATCHOrientPatch();
+	const __m128i wlo = _mm_setr_epi8(-15, -14, -13, -12, -11, -10, -9, -8, -7, -6, -5, -4, -3, -2, -1, 0);
+	const __m128i whi = _mm_setr_epi8(1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16);
+	const __m128i ones = _mm_set1_epi16(1), zero = _mm_setzero_si128();
+	__m128i m10 = zero;
+	int m01 = 0;
+	for (int v = -LATCH_ORIENT_RADIUS; v <= LATCH_ORIENT_RADIUS; ++v) {
+		const uint8_t* const row = p + v * stride;
+		const uint8_t* const m = patch.mask[std::abs(v)];
+		const __m128i lo = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row - LATCH_ORIENT_RADIUS)), _mm_load_si128(reinterpret_cast<const __m128i*>(m)));
+		const __m128i hi = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + 1)), _mm_load_si128(reinterpret_cast<const __m128i*>(m + 16)));
+		m10 = _mm_add_epi32(m10, _mm_madd_epi16(_mm_add_epi16(_mm_maddubs_epi16(lo, wlo), _mm_maddubs_epi16(hi, whi)), ones));
+		const __m128i sum = _mm_add_epi64(_mm_sad_epu8(lo, zero), _mm_sad_epu8(hi, zero));
+		m01 += v * (_mm_cvtsi128_si32(sum) + _mm_extract_epi32(sum, 2));
+	}
+	m10 = _mm_add_epi32(m10, _mm_shuffle_epi32(m10, 78));
+	m10 = _mm_add_epi32(m10, _mm_shuffle_epi32(m10, 177));
+	return std::atan2(static_cast<float>(m01), static_cast<float>(_mm_cvtsi128_si32(m10)));
+}
+
+class LatchDetector {
+public:
+	// 'extractor' (not owned) supplies the threads and, for detect_and_describe(), the border
+	// mode, triplet subset, offset table and output layout; null runs single-threaded with the
+	// defaults
+	explicit LatchDetector(LatchExtractor* const extractor = nullptr) : ex(extractor) {}
+
+	// Detects corners of the image into 'keypoints', replacing its contents: up to
+	// max_keypoints(), in raster order, at least edge() px from the border. Returns their number.
+	int detect(const uint8_t* const __restrict image, const int width, const int height, const int stride, std::vector<KeyPoint>& keypoints) {
+		return run(image, width, height, stride, keypoints, nullptr, nullptr);
+	}
+
+	// As detect(), and describes the keypoints as LatchExtractor::extract() would, while each
+	// band is still in cache. 'descriptors' needs room for
+	// LATCHDescriptorWords(max_keypoints(), words, layout) uint64_t and 'valid', if given, for
+	// max_keypoints() flags. The output is identical to calling extract() on the keypoints.
+	int detect_and_describe(const uint8_t* const __restrict image, const int width, const int height, const int stride, std::vector<KeyPoint>& keypoints, uint64_t* const __restrict descriptors, uint8_t* const __restrict valid = nullptr) {
+		return run(image, width, height, stride, keypoints, descriptors, valid);
+	}
+
+	// Harris response of each keypoint of the last call, on ORB's scale
+	const std::vector<float>& responses() const { return response; }
+
+	// FAST threshold: the arc's pixels must differ from the center by more than this (default 20)
+	int threshold() const { return fast_t; }
+	void set_threshold(const int t) { fast_t = std::min(std::max(t, 1), 254); }
+
+	// keypoints kept per image (default 5000), each band keeping its share by row count
+	int max_keypoints() const { return max_kps; }
+	void set_max_keypoints(const int n) { max_kps = std::max(1, n); }
+
+	// Minimum distance of keypoints from the border (default 37: LATCH describes keypoints
+	// strictly more than 36 px inside, so every keypoint is described; no less than
+	// LATCH_DETECT_MIN_EDGE)
+	int edge() const { return margin; }
+	void set_edge(const int px) { margin = std::max(px, LATCH_DETECT_MIN_EDGE); }
+
+	// KeyPoint::scale given to every keypoint (default 31, ORB's patch size)
+	float keypoint_size() const { return kp_size; }
+	void set_keypoint_size(const float size) { kp_size = size; }
+
+	// rows per band (default 32); keypoint budgets and threads are assigned per band
+	int band_rows() const { return band; }
+	void set_band_rows(const int rows) { band = std::max(8, rows); }
+
+private:
+	struct Candidate {
+		int x, y, score;
+	};
+	struct Corner {
+		float response;
+		int x, y;
+	};
+	// one band's keypoints and, for detect_and_describe(), their linear descriptors
+	struct Band {
+		std::vector<KeyPoint> kps;
+		std::vector<float> response;
+		std::vector<uint64_t> desc;
+		std::vector<uint8_t> valid;
+	};
+	struct Scratch {
+		std::vector<int> xs;
+		std::vector<Candidate> peaks;
+		std::vector<Corner> kept;
+		// FAST scores of rows y - 1, y and y + 1, by (y - top + 1) % 3
+		std::vector<uint16_t> ring;
+	};
+
+	int run(const uint8_t* const image, const int w, const int h, const int stride, std::vector<KeyPoint>& keypoints, uint64_t* const descriptors, uint8_t* const valid) {
+		const int y0 = margin, rows = h - 2 * margin;
+		const int bands = rows > 0 && w > 2 * margin ? (rows + band - 1) / band : 0;
+		if (static_cast<int>(band_buf.size()) < bands) band_buf.resize(bands);
+		_LatchMode mode;
+		if (ex) {
+			mode.border = ex->border_mode();
+			mode.subset = ex->triplet_subset();
+			// as LatchExtractor::run() does
+			mode.table = ex->offset_table() && ex->offset_table()->describes(mode.subset) ? ex->offset_table() : nullptr;
+		}
+		const int words = mode.subset ? mode.subset->words() : 8;
+		const LatchLayout layout = ex ? ex->output_layout() : LatchLayout::Linear;
+		const LatchBitsFn bits = _LATCHActiveBits();
+		const bool avx2 = LATCHActiveKernel() != LatchKernel::SSE41;
+		const int lag = (LATCH_TILE_HALO + band - 1) / band;
+		const int participants = std::max(1, std::min(ex ? ex->thread_pool().size() : 1, bands));
+		if (static_cast<int>(scratch.size()) < participants) scratch.resize(participants);
+		const auto describe = [&](const int b) {
+			Band& bd = band_buf[b];
+			const int n = static_cast<int>(bd.kps.size());
+			bd.desc.resize(static_cast<size_t>(n) * words);
+			bd.valid.resize(n);
+			const LatchFrame f{ image, w, h, stride, bd.kps.data(), n, bd.desc.data(), bd.valid.data() };
+			_LATCH(f, 0, n, bits, mode);
+		};
+		const auto stripe = [&](const int t) {
+			Scratch& s = scratch[t];
+			const int first = static_cast<int>(static_cast<int64_t>(bands) * t / participants), last = static_cast<int>(static_cast<int64_t>(bands) * (t + 1) / participants);
+			for (int b = first; b < last; ++b) {
+				const int top = y0 + b * band, bottom = std::min(y0 + (b + 1) * band, h - margin);
+				const int64_t budget = static_cast<int64_t>(max_kps) * (bottom - y0) / rows - static_cast<int64_t>(max_kps) * (top - y0) / rows;
+				detect_band(image, w, h, stride, top, bottom, static_cast<int>(budget), avx2, s, band_buf[b]);
+				if (descriptors && b - lag >= first) describe(b - lag);
+			}
+			if (descriptors) for (int b = std::max(first, last - lag); b < last; ++b) describe(b);
+		};
+		if (ex && participants > 1) ex->thread_pool().run(stripe, participants);
+		else stripe(0);
+
+		int total = 0;
+		for (int b = 0; b < bands; ++b) total += static_cast<int>(band_buf[b].kps.size());
+		keypoints.clear();
+		response.clear();
+		if (descriptors && layout == LatchLayout::Blocked) linear.resize(static_cast<size_t>(total) * words);
+		uint64_t* const lin = layout == LatchLayout::Blocked ? linear.data() : descriptors;
+		for (int b = 0, at = 0; b < bands; ++b) {
+			const Band& bd = band_buf[b];
+			keypoints.insert(keypoints.end(), bd.kps.begin(), bd.kps.end());
+			response.insert(response.end(), bd.response.begin(), bd.response.end());
+			if (descriptors) {
+				std::copy(bd.desc.begin(), bd.desc.end(), lin + static_cast<size_t>(at) * words);
+				if (valid) std::copy(bd.valid.begin(), bd.valid.end(), valid + at);
+			}
+			at += static_cast<int>(bd.kps.size());
+		}
+		if (descriptors && layout == LatchLayout::Blocked) LATCHToBlocked(lin, total, words, descriptors);
+		return total;
+	}
+
+	// Keeps the n elements of v (in raster order) with the largest key, ties going to the
+	// earlier, in raster order
+	template<typename T, typename Key>
+	static void strongest(std::vector<T>& v, const int n, const Key& key) {
+		if (static_cast<int>(v.size()) <= n) return;
+		const auto raster = [](const T& a, const T& b) { return a.y < b.y || (a.y == b.y && a.x < b.x); };
+		std::nth_element(v.begin(), v.begin() + n, v.end(), [&](const T& a, const T& b) { return key(a) > key(b) || (key(a) == key(b) && raster(a, b)); });
+		v.resize(n);
+		std::sort(v.begin(), v.end(), raster);
+	}
+
+	// FAST over rows [top - 1, bottom + 1), non-max suppression over 3x3 neighborhoods for the
+	// rows [top, bottom), then as in ORB the 2 * budget best by FAST score, of those the 'budget'
+	// best by Harris response, oriented
+	void detect_band(const uint8_t* const image, const int w, const int h, const int stride, const int top, const int bottom, const int budget, const bool avx2, Scratch& s, Band& out) const {
+		const int x0 = margin, x1 = w - margin;
+		// three rows of scores, each with a zero column before x0 and 8 zero lanes after x1
+		const size_t pitch = (static_cast<size_t>(w) + 16) & ~static_cast<size_t>(7);
+		s.ring.assign(3 * pitch, 0);
+		const auto score_row = [&](const int y) {
+			uint16_t* const scores = s.ring.data() + (y - top + 1) % 3 * pitch;
+			const uint8_t* const row = image + static_cast<ptrdiff_t>(y) * stride;
+			if (y < margin || y >= h - margin) std::fill(scores + x0, scores + x1, 0);
+			else if (avx2 && x1 - x0 >= 32) _LATCHFastRowAVX2(row, stride, x0, x1, fast_t, scores);
+			else if (x1 - x0 >= 16) _LATCHFastRowSSE41(row, stride, x0, x1, fast_t, scores);
+			else for (int x = x0; x < x1; ++x) scores[x] = static_cast<uint16_t>(_LATCHFast(row + x, stride, fast_t) ? _LATCHFastScore(row + x, stride, fast_t) : 0);
+		};
+		score_row(top - 1);
+		score_row(top);
+		s.peaks.clear();
+		for (int y = top; y < bottom; ++y) {
+			score_row(y + 1);
+			const uint16_t* const mid = s.ring.data() + (y - top + 1) % 3 * pitch;
+			s.xs.clear();
+			_LATCHPeaks(s.ring.data() + (y - top) % 3 * pitch, mid, s.ring.data() + (y - top + 2) % 3 * pitch, x0, x1, s.xs);
+			for (const int x : s.xs) s.peaks.push_back(Candidate{ x, y, mid[x] });
+		}
+		strongest(s.peaks, 2 * budget, [](const Candidate& c) { return c.score; });
+		s.kept.clear();
+		for (auto&& c : s.peaks) s.kept.push_back(Corner{ _LATCHHarrisSSE41(image + static_cast<ptrdiff_t>(c.y) * stride + c.x, stride), c.x, c.y });
+		strongest(s.kept, budget, [](const Corner& c) { return c.response; });
+		out.kps.clear();
+		out.response.clear();
+		for (auto&& c : s.kept) {
+			out.kps.emplace_back(static_cast<float>(c.x), static_cast<float>(c.y), kp_size, _LATCHOrientation(image + static_cast<ptrdiff_t>(c.y) * stride + c.x, stride));
+			out.response.push_back(c.response);
+		}
+	}
+
+	LatchExtractor* ex;
+	int fast_t = 20;
+	int max_kps = 5000;
+	int margin = 37;
+	float kp_size = 31.0f;
+	int band = 32;
+	std::vector<Band> band_buf;
+	std::vector<Scratch> scratch;
+	std::vector<float> response;
+	std::vector<uint64_t> linear;
+};
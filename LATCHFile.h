@@ -0,0 +1,245 @@
+/*******************************************************************
+*   LATCHFile.h
+*   LATCH
+*
+*	Author: Kareem Omar
+*	kareem.omar@uah.edu
+*	https://github.com/komrad36
+*
+*******************************************************************/
+//
+// Versioned binary container for LATCH output, laid out so that a
+// memory mapping of the file can be used as is:
+//
+//   bytes 0-63    LatchFileHeader
+//   keypoints     x[count], y[count], scale[count], angle[count]
+//                 (float, each array 64-byte aligned)
+//   descriptors   count * words uint64_t, 64-byte aligned, in the
+//                 layout they were written with (see LatchLayout)
+//   valid         count uint8_t, if written
+//
+// All values are native little-endian. Section offsets are stored in
+// the header, so readers never assume the layout above. LatchFile
+// maps a file and hands back pointers into the mapping, so e.g.
+// LATCHKnn() can match against a cached file without copying.
+//
+
+#pragma once
+
+#include "LATCH.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only memory mapping of a whole file; empty if the file could not be mapped
+class LatchMapping {
+public:
+	LatchMapping() {}
+	explicit LatchMapping(const char* const path) {
+#ifdef _WIN32
+		const HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return;
+		LARGE_INTEGER size;
+		if (GetFileSizeEx(file, &size) && size.QuadPart > 0 && static_cast<unsigned long long>(size.QuadPart) <= SIZE_MAX) {
+			// the view keeps the mapping alive, so both handles can be closed
+			const HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mapping) {
+				void* const p = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+				if (p) {
+					addr = p;
+					len = static_cast<size_t>(size.QuadPart);
+				}
+				CloseHandle(mapping);
+			}
+		}
+		CloseHandle(file);
+#else
+		const int fd = ::open(path, O_RDONLY);
+		if (fd < 0) return;
+		struct stat st;
+		if (fstat(fd, &st) == 0 && st.st_size > 0) {
+			void* const p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+			if (p != MAP_FAILED) {
+				addr = p;
+				len = static_cast<size_t>(st.st_size);
+			}
+		}
+		::close(fd);
+#endif
+	}
+	LatchMapping(const LatchMapping&) = delete;
+	LatchMapping& operator=(const LatchMapping&) = delete;
+	LatchMapping(LatchMapping&& other) noexcept : addr(other.addr), len(other.len) {
+		other.addr = nullptr;
+		other.len = 0;
+	}
+	LatchMapping& operator=(LatchMapping&& other) noexcept {
+		std::swap(addr, other.addr);
+		std::swap(len, other.len);
+		return *this;
+	}
+	~LatchMapping() {
+#ifdef _WIN32
+		if (addr) UnmapViewOfFile(addr);
+#else
+		if (addr) munmap(addr, len);
+#endif
+	}
+
+	const uint8_t* data() const { return static_cast<const uint8_t*>(addr); }
+	size_t size() const { return len; }
+	explicit operator bool() const { return addr != nullptr; }
+
+private:
+	void* addr = nullptr;
+	size_t len = 0;
+};
+
+constexpr uint32_t LATCH_FILE_VERSION = 1;
+
+struct LatchFileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t count;
+	// uint64_t per descriptor: 8, or LatchTripletSubset::words()
+	uint32_t words;
+	// LatchLayout of the descriptors
+	uint32_t layout;
+	// byte offsets of the sections; valid is 0 if absent
+	uint64_t keypoints;
+	uint64_t descriptors;
+	uint64_t valid;
+	uint8_t reserved[16];
+};
+static_assert(sizeof(LatchFileHeader) == 64, "file header must stay 64 bytes");
+
+inline uint64_t _LATCHAlign64(const uint64_t n) { return (n + 63) & ~uint64_t(63); }
+
+// Header for count descriptors of 'words' words in 'layout', with sections placed as described above
+inline LatchFileHeader _LATCHFileHeader(const int count, const int words, const LatchLayout layout, const bool has_valid) {
+	LatchFileHeader h = {};
+	std::memcpy(h.magic, "LATCHDSC", 8);
+	h.version = LATCH_FILE_VERSION;
+	h.count = static_cast<uint32_t>(count);
+	h.words = static_cast<uint32_t>(words);
+	h.layout = static_cast<uint32_t>(layout);
+	h.keypoints = sizeof(LatchFileHeader);
+	h.descriptors = h.keypoints + 4 * _LATCHAlign64(4 * static_cast<uint64_t>(count));
+	h.valid = has_valid ? h.descriptors + 8 * static_cast<uint64_t>(LATCHDescriptorWords(count, words, layout)) : 0;
+	return h;
+}
+
+inline bool _LATCHPad(FILE* const file, const uint64_t to) {
+	static const uint8_t zeros[64] = {};
+	const long at = ftell(file);
+	return at >= 0 && static_cast<uint64_t>(at) <= to && fwrite(zeros, 1, static_cast<size_t>(to - static_cast<uint64_t>(at)), file) == to - static_cast<uint64_t>(at);
+}
+
+// Writes 'keypoints' and their descriptors (as passed to LATCH(), LatchExtractor::extract() or
+// LatchFile::descriptors(): 'words' uint64_t each, in 'layout') and, if given, valid flags to
+// 'path'. Descriptors are written straight from the buffer. Returns false on I/O failure.
+inline bool LATCHWriteFile(const char* const path, const LatchKeyPointsSoA& keypoints, const uint64_t* const descriptors, const uint8_t* const valid = nullptr, const int words = 8, const LatchLayout layout = LatchLayout::Linear) {
+	const int count = keypoints.count;
+	const LatchFileHeader h = _LATCHFileHeader(count, words, layout, valid != nullptr);
+	FILE* const file = fopen(path, "wb");
+	if (!file) return false;
+	const size_t n = static_cast<size_t>(count);
+	std::vector<float> angle;
+	if (!keypoints.angle) {
+		angle.resize(n);
+		for (size_t i = 0; i < n; ++i) angle[i] = std::atan2(keypoints.sin_angle[i], keypoints.cos_angle[i]);
+	}
+	const float* const arrays[4] = { keypoints.x, keypoints.y, keypoints.scale, keypoints.angle ? keypoints.angle : angle.data() };
+	bool ok = fwrite(&h, sizeof(h), 1, file) == 1;
+	for (int a = 0; a < 4; ++a) ok = ok && _LATCHPad(file, h.keypoints + a * _LATCHAlign64(4 * n)) && fwrite(arrays[a], sizeof(float), n, file) == n;
+	const size_t nwords = LATCHDescriptorWords(count, words, layout);
+	ok = ok && _LATCHPad(file, h.descriptors) && fwrite(descriptors, sizeof(uint64_t), nwords, file) == nwords;
+	ok = ok && (!valid || fwrite(valid, 1, n, file) == n);
+	return fclose(file) == 0 && ok;
+}
+
+// AoS keypoints, otherwise as above
+inline bool LATCHWriteFile(const char* const path, const KeyPoint* const keypoints, const int count, const uint64_t* const descriptors, const uint8_t* const valid = nullptr, const int words = 8, const LatchLayout layout = LatchLayout::Linear) {
+	std::vector<float> soa(4 * static_cast<size_t>(count));
+	float* const x = soa.data(), * const y = x + count, * const scale = y + count, * const angle = scale + count;
+	for (int i = 0; i < count; ++i) {
+		x[i] = keypoints[i].x;
+		y[i] = keypoints[i].y;
+		scale[i] = keypoints[i].scale;
+		angle[i] = keypoints[i].angle;
+	}
+	return LATCHWriteFile(path, LatchKeyPointsSoA{ x, y, scale, angle, nullptr, nullptr, count }, descriptors, valid, words, layout);
+}
+
+// A file written by LATCHWriteFile(), mapped read-only. Accessors point into the mapping and
+// stay valid until the LatchFile is destroyed or reopened.
+class LatchFile {
+public:
+	LatchFile() {}
+	explicit LatchFile(const char* const path) { open(path); }
+
+	// Returns false, leaving the file closed, if it is missing, truncated or not a version 1 file
+	bool open(const char* const path) {
+		close();
+		LatchMapping file(path);
+		if (!file || file.size() < sizeof(LatchFileHeader)) return false;
+		LatchFileHeader h;
+		std::memcpy(&h, file.data(), sizeof(h));
+		if (std::memcmp(h.magic, "LATCHDSC", 8) || h.version != LATCH_FILE_VERSION || h.count > 0x7FFFFFFF || h.words < 1 || h.words > 8 || h.layout > static_cast<uint32_t>(LatchLayout::Blocked)) return false;
+		const uint64_t n = h.count;
+		const uint64_t desc_bytes = 8 * static_cast<uint64_t>(LATCHDescriptorWords(static_cast<int>(n), static_cast<int>(h.words), static_cast<LatchLayout>(h.layout)));
+		// sections must be aligned and lie inside the file
+		if ((h.keypoints | h.descriptors) & 63 || h.keypoints + 4 * _LATCHAlign64(4 * n) > file.size() || h.descriptors + desc_bytes > file.size() || (h.valid && h.valid + n > file.size())) return false;
+		hdr = h;
+		map = std::move(file);
+		return true;
+	}
+
+	void close() {
+		map = LatchMapping();
+		hdr = LatchFileHeader();
+	}
+
+	bool is_open() const { return static_cast<bool>(map); }
+	int count() const { return static_cast<int>(hdr.count); }
+	int words() const { return static_cast<int>(hdr.words); }
+	LatchLayout layout() const { return static_cast<LatchLayout>(hdr.layout); }
+
+	// Keypoints with angle given (sin_angle / cos_angle null)
+	LatchKeyPointsSoA keypoints() const {
+		const size_t pitch = static_cast<size_t>(_LATCHAlign64(4 * static_cast<uint64_t>(hdr.count))) / sizeof(float);
+		const float* const x = reinterpret_cast<const float*>(map.data() + hdr.keypoints);
+		return LatchKeyPointsSoA{ x, x + pitch, x + 2 * pitch, x + 3 * pitch, nullptr, nullptr, count() };
+	}
+
+	KeyPoint keypoint(const int i) const {
+		const LatchKeyPointsSoA k = keypoints();
+		return KeyPoint(k.x[i], k.y[i], k.scale[i], k.angle[i]);
+	}
+
+	// 64-byte aligned, words() uint64_t per keypoint in layout()
+	const uint64_t* descriptors() const { return reinterpret_cast<const uint64_t*>(map.data() + hdr.descriptors); }
+
+	// nullptr if the file has no valid flags
+	const uint8_t* valid() const { return hdr.valid ? map.data() + hdr.valid : nullptr; }
+
+private:
+	LatchMapping map;
+	LatchFileHeader hdr = {};
+};
@@ -0,0 +1,238 @@
+/*******************************************************************
+*   LATCHIndex.h
+*   LATCH
+*
+*	Author: Kareem Omar
+*	kareem.omar@uah.edu
+*	https://github.com/komrad36
+*
+*******************************************************************/
+//
+// Multi-index hashing (Norouzi, Punjani & Fleet) over the 512-bit
+// descriptors written by LATCH() and LatchExtractor, for matching
+// against databases too large for LATCHKnn()'s brute force.
+//
+// Each descriptor is split into 32 16-bit substrings and filed under
+// each of them in one of 32 direct-addressed tables. By pigeonhole, a
+// descriptor within Hamming distance 32 * (r + 1) - 1 of a query agrees
+// with it to within r bits on at least one substring, so probing every
+// bucket within r bits of each query substring finds it. Queries
+// widen r until their best match is inside that guarantee (or
+// max_radius is reached), so queries with a close match, the ones that
+// matter, stop after probing few buckets.
+//
+// Tables are stored CSR style: per table, 65537 bucket offsets and the
+// ids sorted by bucket. Inserted descriptors go to a pending list,
+// searched by brute force, and are folded into the tables once it grows
+// past an eighth of the index, so inserts cost O(1) amortized.
+//
+// save() writes the index as one file that open() maps read-only, so a
+// service starts without rebuilding; inserting into an opened index
+// copies it into memory first.
+//
+
+#pragma once
+
+#include "LATCHFile.h"
+#include "LATCHMatcher.h"
+
+constexpr int LATCH_INDEX_SUBSTRINGS = 32;
+constexpr int LATCH_INDEX_BUCKETS = 1 << 16;
+
+// File header; descriptors follow at byte 64, then the bucket offsets, then the ids
+struct LatchIndexHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t substrings;
+	uint64_t count;
+	uint8_t reserved[40];
+};
+static_assert(sizeof(LatchIndexHeader) == 64, "index header must stay 64 bytes");
+
+// All 16-bit masks ordered by popcount; masks of popcount r are [start[r], start[r + 1])
+struct _LatchIndexMasks {
+	uint16_t mask[LATCH_INDEX_BUCKETS];
+	int start[18];
+
+	_LatchIndexMasks() {
+		int n = 0;
+		for (int r = 0; r <= 16; ++r) {
+			start[r] = n;
+			for (int m = 0; m < LATCH_INDEX_BUCKETS; ++m) {
+				if (static_cast<int>(std::bitset<16>(static_cast<unsigned>(m)).count()) == r) mask[n++] = static_cast<uint16_t>(m);
+			}
+		}
+		start[17] = n;
+	}
+};
+
+inline const _LatchIndexMasks& _LATCHIndexMasks() {
+	static const _LatchIndexMasks masks;
+	return masks;
+}
+
+inline uint32_t _LATCHSubstring(const uint64_t* const desc, const int s) {
+	return static_cast<uint32_t>(desc[s >> 2] >> ((s & 3) << 4)) & 0xFFFF;
+}
+
+// As _LATCHKnnInsert(), but ties resolve to the lower id whatever the visiting order, and an
+// id already held (a hit in a second table) is not inserted again
+inline void _LATCHKnnInsertOrdered(LatchKnn& k, const int d, const int j) {
+	if (j == k.train[0] || j == k.train[1]) return;
+	if (d < k.distance[1] || (d == k.distance[1] && j < k.train[1])) {
+		if (d < k.distance[0] || (d == k.distance[0] && j < k.train[0])) {
+			k.distance[1] = k.distance[0];
+			k.train[1] = k.train[0];
+			k.distance[0] = d;
+			k.train[0] = j;
+		}
+		else {
+			k.distance[1] = d;
+			k.train[1] = j;
+		}
+	}
+}
+
+class LatchIndex {
+public:
+	LatchIndex() {}
+
+	// Appends n descriptors (8 uint64_t each), which get ids size(), size() + 1, ...
+	void insert(const uint64_t* const descriptors, const int n) {
+		if (n <= 0) return;
+		own();
+		desc_buf.insert(desc_buf.end(), descriptors, descriptors + (static_cast<size_t>(n) << 3));
+		descs = desc_buf.data();
+		count += n;
+		if (count - indexed > std::max<int64_t>(4096, indexed >> 3)) compact();
+	}
+
+	int size() const { return static_cast<int>(count); }
+	const uint64_t* descriptor(const int id) const { return descs + (static_cast<size_t>(id) << 3); }
+
+	// descriptors not yet in the tables, searched by brute force until the next compact()
+	int pending() const { return static_cast<int>(count - indexed); }
+
+	// Files every pending descriptor into the tables
+	void compact() {
+		if (indexed == count) return;
+		own();
+		offset_buf.assign(static_cast<size_t>(LATCH_INDEX_SUBSTRINGS) * (LATCH_INDEX_BUCKETS + 1), 0);
+		id_buf.resize(static_cast<size_t>(LATCH_INDEX_SUBSTRINGS) * count);
+		for (int s = 0; s < LATCH_INDEX_SUBSTRINGS; ++s) {
+			uint32_t* const __restrict off = offset_buf.data() + static_cast<size_t>(s) * (LATCH_INDEX_BUCKETS + 1);
+			uint32_t* const __restrict ids = id_buf.data() + static_cast<size_t>(s) * count;
+			for (int64_t i = 0; i < count; ++i) ++off[_LATCHSubstring(descs + (i << 3), s) + 1];
+			for (int b = 0; b < LATCH_INDEX_BUCKETS; ++b) off[b + 1] += off[b];
+			// fill by advancing each bucket's start, then shift the starts back into place
+			for (int64_t i = 0; i < count; ++i) ids[off[_LATCHSubstring(descs + (i << 3), s)]++] = static_cast<uint32_t>(i);
+			for (int b = LATCH_INDEX_BUCKETS; b > 0; --b) off[b] = off[b - 1];
+			off[0] = 0;
+		}
+		offsets = offset_buf.data();
+		ids_all = id_buf.data();
+		indexed = count;
+	}
+
+	// 2-NN of each of the nq query descriptors, in the format of LATCHKnn(). The best match
+	// equals LATCHKnn()'s whenever its distance is below 32 * (max_radius + 1) (otherwise it
+	// may be missed). The second best is the best other descriptor seen on the way, so it is
+	// exact when searching stopped only after passing it, and an upper bound otherwise.
+	// Each probe radius r costs C(16, r) bucket lookups per substring. Pass a pool (e.g.
+	// LatchExtractor::thread_pool()) to spread the queries over its threads. Safe to call
+	// concurrently, but not with insert(), compact() or open().
+	void knn(const uint64_t* const __restrict query, const int nq, LatchKnn* const __restrict out, LatchPool* const pool = nullptr, const int max_radius = 2) const {
+		constexpr int tile = 16;
+		const int tiles = (nq + tile - 1) / tile;
+		std::atomic<int> next{ 0 };
+		const auto work = [&](const int) {
+			for (int t; (t = next.fetch_add(1, std::memory_order_relaxed)) < tiles;) {
+				for (int i = t * tile; i < std::min(nq, (t + 1) * tile); ++i) out[i] = search(query + (static_cast<size_t>(i) << 3), max_radius);
+			}
+		};
+		if (pool) pool->run(work, std::max(1, tiles));
+		else work(0);
+	}
+
+	// Writes the index, compacted, to 'path' for open(). Returns false on I/O failure.
+	bool save(const char* const path) {
+		compact();
+		FILE* const file = fopen(path, "wb");
+		if (!file) return false;
+		LatchIndexHeader header = {};
+		std::memcpy(header.magic, "LATCHIDX", 8);
+		header.version = 1;
+		header.substrings = LATCH_INDEX_SUBSTRINGS;
+		header.count = static_cast<uint64_t>(count);
+		const size_t noffsets = count ? static_cast<size_t>(LATCH_INDEX_SUBSTRINGS) * (LATCH_INDEX_BUCKETS + 1) : 0;
+		bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+		ok = ok && (!count || fwrite(descs, sizeof(uint64_t) << 3, static_cast<size_t>(count), file) == static_cast<size_t>(count));
+		ok = ok && (!count || fwrite(offsets, sizeof(uint32_t), noffsets, file) == noffsets);
+		ok = ok && (!count || fwrite(ids_all, sizeof(uint32_t) * LATCH_INDEX_SUBSTRINGS, static_cast<size_t>(count), file) == static_cast<size_t>(count));
+		return fclose(file) == 0 && ok;
+	}
+
+	// Maps an index written by save(), replacing the current contents. Descriptors and tables
+	// are read in place from the page cache. Returns false, leaving the index empty, if the
+	// file is missing, truncated or not a version 1 index.
+	bool open(const char* const path) {
+		*this = LatchIndex();
+		LatchMapping file(path);
+		if (!file || file.size() < sizeof(LatchIndexHeader)) return false;
+		LatchIndexHeader header;
+		std::memcpy(&header, file.data(), sizeof(header));
+		if (std::memcmp(header.magic, "LATCHIDX", 8) || header.version != 1 || header.substrings != LATCH_INDEX_SUBSTRINGS || header.count > 0x7FFFFFFF) return false;
+		const size_t n = static_cast<size_t>(header.count);
+		const size_t noffsets = n ? static_cast<size_t>(LATCH_INDEX_SUBSTRINGS) * (LATCH_INDEX_BUCKETS + 1) : 0;
+		if (file.size() != sizeof(header) + 64 * n + 4 * noffsets + 4 * n * LATCH_INDEX_SUBSTRINGS) return false;
+		descs = reinterpret_cast<const uint64_t*>(file.data() + sizeof(header));
+		offsets = reinterpret_cast<const uint32_t*>(file.data() + sizeof(header) + 64 * n);
+		ids_all = offsets + noffsets;
+		count = indexed = static_cast<int64_t>(n);
+		mapping = std::move(file);
+		return true;
+	}
+
+private:
+	// Moves mapped contents into owned buffers so they can grow
+	void own() {
+		if (!mapping) return;
+		desc_buf.assign(descs, descs + (static_cast<size_t>(count) << 3));
+		const size_t noffsets = indexed ? static_cast<size_t>(LATCH_INDEX_SUBSTRINGS) * (LATCH_INDEX_BUCKETS + 1) : 0;
+		offset_buf.assign(offsets, offsets + noffsets);
+		id_buf.assign(ids_all, ids_all + static_cast<size_t>(LATCH_INDEX_SUBSTRINGS) * indexed);
+		descs = desc_buf.data();
+		offsets = offset_buf.data();
+		ids_all = id_buf.data();
+		mapping = LatchMapping();
+	}
+
+	LatchKnn search(const uint64_t* const __restrict q, const int max_radius) const {
+		LatchKnn k{ { -1, -1 }, { 513, 513 } };
+		for (int64_t j = indexed; j < count; ++j) _LATCHKnnInsertOrdered(k, _LATCHHamming(q, descs + (j << 3)), static_cast<int>(j));
+		if (!indexed) return k;
+		const _LatchIndexMasks& masks = _LATCHIndexMasks();
+		for (int r = 0; r <= std::min(max_radius, 16); ++r) {
+			for (int s = 0; s < LATCH_INDEX_SUBSTRINGS; ++s) {
+				const uint32_t* const __restrict off = offsets + static_cast<size_t>(s) * (LATCH_INDEX_BUCKETS + 1);
+				const uint32_t* const __restrict ids = ids_all + static_cast<size_t>(s) * indexed;
+				const uint32_t key = _LATCHSubstring(q, s);
+				for (int m = masks.start[r]; m < masks.start[r + 1]; ++m) {
+					const uint32_t b = key ^ masks.mask[m];
+					for (uint32_t e = off[b]; e < off[b + 1]; ++e) _LATCHKnnInsertOrdered(k, _LATCHHamming(q, descs + (static_cast<size_t>(ids[e]) << 3)), static_cast<int>(ids[e]));
+				}
+			}
+			// every descriptor within 32 * (r + 1) - 1 bits has now been seen
+			if (k.distance[0] < LATCH_INDEX_SUBSTRINGS * (r + 1)) break;
+		}
+		return k;
+	}
+
+	int64_t count = 0, indexed = 0;
+	const uint64_t* descs = nullptr;
+	const uint32_t* offsets = nullptr;
+	const uint32_t* ids_all = nullptr;
+	std::vector<uint64_t> desc_buf;
+	std::vector<uint32_t> offset_buf, id_buf;
+	LatchMapping mapping;
+};
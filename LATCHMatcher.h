@@ -0,0 +1,323 @@
+/*******************************************************************
+*   LATCHMatcher.h
+*   LATCH
+*
+*	Author: Kareem Omar
+*	kareem.omar@uah.edu
+*	https://github.com/komrad36
+*
+*******************************************************************/
+//
+// Brute-force Hamming matcher for the 512-bit descriptors written by
+// LATCH() and LatchExtractor: 8 uint64_t per keypoint, contiguous.
+//
+// Query and train sets are tiled so that a block of train descriptors
+// stays resident in L1/L2 while a block of queries is swept over it,
+// and query tiles are spread over a LatchPool exactly like keypoints
+// are during extraction.
+//
+// AVX-512 VPOPCNTQ is used when the CPU has it, otherwise AVX2
+// nibble-LUT (vpshufb) popcounts, otherwise scalar popcnt; the choice
+// follows LATCHActiveKernel(). Each 512-bit distance is independent, so
+// there is no long stream for Harley-Seal accumulation to amortize
+// over; instead four distances are packed into 16-bit fields and
+// reduced horizontally together.
+//
+// LATCHKnnMasked() and LATCHMatchMasked() also take the unstable masks
+// of both sets (see LatchFrame::unstable). They compare only the bits
+// stable in both descriptors, scaled to the full 512 bits, so an
+// ambiguous bit can neither create nor hide a match. Pairs sharing too
+// few stable bits are rejected outright, before geometric verification.
+//
+
+#pragma once
+
+#include "LATCH.h"
+
+#include <nmmintrin.h>
+
+struct LatchMatch {
+	int query, train;
+	int distance;
+};
+
+// Best and second best train match of one query.
+// Absent entries (fewer than 2 train descriptors) have train -1 and distance 513.
+struct LatchKnn {
+	int train[2];
+	int distance[2];
+};
+
+// rows of the query / train matrices swept per tile
+constexpr int LATCH_MATCH_QUERY_TILE = 32;
+constexpr int LATCH_MATCH_TRAIN_TILE = 512;
+
+LATCH_TARGET("popcnt") inline int _LATCHHamming(const uint64_t* const __restrict a, const uint64_t* const __restrict b) {
+	int d = 0;
+	for (int i = 0; i < 8; ++i) d += static_cast<int>(_mm_popcnt_u64(a[i] ^ b[i]));
+	return d;
+}
+
+inline void _LATCHKnnInsert(LatchKnn& k, const int d, const int j) {
+	if (d < k.distance[1]) {
+		if (d < k.distance[0]) {
+			k.distance[1] = k.distance[0];
+			k.train[1] = k.train[0];
+			k.distance[0] = d;
+			k.train[0] = j;
+		}
+		else {
+			k.distance[1] = d;
+			k.train[1] = j;
+		}
+	}
+}
+
+// Each row kernel matches q against train[t0, t1), folding results into k
+typedef void (*LatchKnnRowFn)(const uint64_t* __restrict, const uint64_t* __restrict, int, int, LatchKnn&);
+
+LATCH_TARGET("popcnt") inline void _LATCHKnnRowPOPCNT(const uint64_t* const __restrict q, const uint64_t* const __restrict train, const int t0, const int t1, LatchKnn& k) {
+	int j = t0;
+	for (; j < t1; ++j) _LATCHKnnInsert(k, _LATCHHamming(q, train + (static_cast<size_t>(j) << 3)), j);
+}
+
+// Per-qword popcounts of the 512 bits x0:x1
+LATCH_TARGET("avx2") inline __m256i _LATCHCountAVX2(const __m256i x0, const __m256i x1) {
+	const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i nib = _mm256_set1_epi8(0x0F);
+	const __m256i c0 = _mm256_add_epi8(_mm256_shuffle_epi8(lut, _mm256_and_si256(x0, nib)), _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(x0, 4), nib)));
+	const __m256i c1 = _mm256_add_epi8(_mm256_shuffle_epi8(lut, _mm256_and_si256(x1, nib)), _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(x1, 4), nib)));
+	return _mm256_sad_epu8(_mm256_add_epi8(c0, c1), _mm256_setzero_si256());
+}
+
+// Per-qword popcounts of the 512-bit q ^ t, q held in two ymm registers
+LATCH_TARGET("avx2") inline __m256i _LATCHPopcntAVX2(const __m256i q0, const __m256i q1, const uint64_t* const __restrict t) {
+	return _LATCHCountAVX2(_mm256_xor_si256(q0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(t))), _mm256_xor_si256(q1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(t + 4))));
+}
+
+LATCH_TARGET("avx2,popcnt") inline void _LATCHKnnRowAVX2(const uint64_t* const __restrict q, const uint64_t* const __restrict train, const int t0, const int t1, LatchKnn& k) {
+	int j = t0;
+	const __m256i q0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(q)), q1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(q + 4));
+	for (; j + 4 <= t1; j += 4) {
+		const uint64_t* const __restrict t = train + (static_cast<size_t>(j) << 3);
+		// per-qword sums are <= 128, so four trains pack into 16-bit fields of one reduction
+		const __m256i s = _mm256_add_epi64(_mm256_add_epi64(_LATCHPopcntAVX2(q0, q1, t), _mm256_slli_epi64(_LATCHPopcntAVX2(q0, q1, t + 8), 16)), _mm256_add_epi64(_mm256_slli_epi64(_LATCHPopcntAVX2(q0, q1, t + 16), 32), _mm256_slli_epi64(_LATCHPopcntAVX2(q0, q1, t + 24), 48)));
+		const __m128i h = _mm_add_epi64(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+		const uint64_t packed = static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_add_epi64(h, _mm_unpackhi_epi64(h, h))));
+		for (int m = 0; m < 4; ++m) _LATCHKnnInsert(k, static_cast<int>((packed >> (m << 4)) & 0xFFFF), j + m);
+	}
+	for (; j < t1; ++j) _LATCHKnnInsert(k, _LATCHHamming(q, train + (static_cast<size_t>(j) << 3)), j);
+}
+
+LATCH_TARGET("avx512f,avx512vpopcntdq,popcnt") inline void _LATCHKnnRowAVX512(const uint64_t* const __restrict q, const uint64_t* const __restrict train, const int t0, const int t1, LatchKnn& k) {
+	int j = t0;
+	const __m512i qv = _mm512_loadu_si512(q);
+	for (; j + 4 <= t1; j += 4) {
+		const uint64_t* const __restrict t = train + (static_cast<size_t>(j) << 3);
+		// per-qword counts are <= 64, so four trains pack into 16-bit fields of one reduction
+		const __m512i p0 = _mm512_popcnt_epi64(_mm512_xor_si512(qv, _mm512_loadu_si512(t)));
+		const __m512i p1 = _mm512_popcnt_epi64(_mm512_xor_si512(qv, _mm512_loadu_si512(t + 8)));
+		const __m512i p2 = _mm512_popcnt_epi64(_mm512_xor_si512(qv, _mm512_loadu_si512(t + 16)));
+		const __m512i p3 = _mm512_popcnt_epi64(_mm512_xor_si512(qv, _mm512_loadu_si512(t + 24)));
+		// (maskz forms: GCC's -Wmaybe-uninitialized misfires on the unmasked ones under LTO)
+		const __m512i s = _mm512_add_epi64(_mm512_add_epi64(p0, _mm512_maskz_slli_epi64(0xFF, p1, 16)), _mm512_add_epi64(_mm512_maskz_slli_epi64(0xFF, p2, 32), _mm512_maskz_slli_epi64(0xFF, p3, 48)));
+		const __m256i s4 = _mm256_add_epi64(_mm512_maskz_extracti64x4_epi64(0xF, s, 0), _mm512_maskz_extracti64x4_epi64(0xF, s, 1));
+		const __m128i h = _mm_add_epi64(_mm256_castsi256_si128(s4), _mm256_extracti128_si256(s4, 1));
+		const uint64_t packed = static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_add_epi64(h, _mm_unpackhi_epi64(h, h))));
+		for (int m = 0; m < 4; ++m) _LATCHKnnInsert(k, static_cast<int>((packed >> (m << 4)) & 0xFFFF), j + m);
+	}
+	for (; j < t1; ++j) _LATCHKnnInsert(k, _LATCHHamming(q, train + (static_cast<size_t>(j) << 3)), j);
+}
+
+// Follows the active extraction kernel (see LATCHSetKernel()), so overriding that
+// to a narrower ISA narrows the matcher too.
+inline LatchKnnRowFn _LATCHActiveKnnRow() {
+	const _LatchCpu& cpu = _LATCHCpu();
+	const LatchKernel k = LATCHActiveKernel();
+	if (k >= LatchKernel::AVX512 && cpu.avx512vpopcntdq) return _LATCHKnnRowAVX512;
+	if (k >= LatchKernel::AVX2) return _LATCHKnnRowAVX2;
+	return _LATCHKnnRowPOPCNT;
+}
+
+// 512 / s in 16.16 fixed point, for s in [1, 512]
+struct _LatchMaskedScale {
+	uint32_t scale[513];
+
+	_LatchMaskedScale() {
+		scale[0] = 0;
+		for (uint32_t s = 1; s <= 512; ++s) scale[s] = ((512U << 16) + s / 2) / s;
+	}
+};
+
+inline const _LatchMaskedScale& _LATCHMaskedScale() {
+	static const _LatchMaskedScale scale;
+	return scale;
+}
+
+// Masked distance of a pair with 'differ' differing bits among 'stable' bits stable in both:
+// 512 * differ / stable, rounded (by a table, not a division), or 513 (never a match) if
+// stable < min_stable, with 'scale' the table of _LATCHMaskedScale()
+// (differ <= stable, so the product fits 32 bits)
+inline int _LATCHMaskedDistance(const int differ, const int stable, const int min_stable, const uint32_t* const __restrict scale) {
+	if (stable < std::max(min_stable, 1)) return 513;
+	return static_cast<int>((static_cast<uint32_t>(differ) * scale[stable] + 0x8000) >> 16);
+}
+
+LATCH_TARGET("popcnt") inline int _LATCHMaskedHamming(const uint64_t* const __restrict a, const uint64_t* const __restrict ua, const uint64_t* const __restrict b, const uint64_t* const __restrict ub, const int min_stable, const uint32_t* const __restrict scale) {
+	int differ = 0, unstable = 0;
+	for (int i = 0; i < 8; ++i) {
+		const uint64_t m = ua[i] | ub[i];
+		differ += static_cast<int>(_mm_popcnt_u64((a[i] ^ b[i]) & ~m));
+		unstable += static_cast<int>(_mm_popcnt_u64(m));
+	}
+	return _LATCHMaskedDistance(differ, 512 - unstable, min_stable, scale);
+}
+
+// As LatchKnnRowFn, with the unstable masks of q and train and the minimum number of shared stable bits
+typedef void (*LatchKnnMaskedRowFn)(const uint64_t* __restrict, const uint64_t* __restrict, const uint64_t* __restrict, const uint64_t* __restrict, int, int, int, LatchKnn&);
+
+LATCH_TARGET("popcnt") inline void _LATCHKnnMaskedRowPOPCNT(const uint64_t* const __restrict q, const uint64_t* const __restrict qu, const uint64_t* const __restrict train, const uint64_t* const __restrict tu, const int t0, const int t1, const int min_stable, LatchKnn& k) {
+	const uint32_t* const __restrict scale = _LATCHMaskedScale().scale;
+	for (int j = t0; j < t1; ++j) _LATCHKnnInsert(k, _LATCHMaskedHamming(q, qu, train + (static_cast<size_t>(j) << 3), tu + (static_cast<size_t>(j) << 3), min_stable, scale), j);
+}
+
+// Per-qword popcounts of the bits of q ^ t stable in both (differ) and of those unstable in either (unstable)
+LATCH_TARGET("avx2") inline void _LATCHMaskedCountAVX2(const __m256i q0, const __m256i q1, const __m256i qu0, const __m256i qu1, const uint64_t* const __restrict t, const uint64_t* const __restrict tu, __m256i& differ, __m256i& unstable) {
+	const __m256i m0 = _mm256_or_si256(qu0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(tu))), m1 = _mm256_or_si256(qu1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(tu + 4)));
+	differ = _LATCHCountAVX2(_mm256_andnot_si256(m0, _mm256_xor_si256(q0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(t)))), _mm256_andnot_si256(m1, _mm256_xor_si256(q1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(t + 4)))));
+	unstable = _LATCHCountAVX2(m0, m1);
+}
+
+// Sum of the four qwords of s, whose 16-bit fields hold four separate counts
+LATCH_TARGET("avx2") inline uint64_t _LATCHSumPackedAVX2(const __m256i s) {
+	const __m128i h = _mm_add_epi64(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+	return static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_add_epi64(h, _mm_unpackhi_epi64(h, h))));
+}
+
+LATCH_TARGET("avx2,popcnt") inline void _LATCHKnnMaskedRowAVX2(const uint64_t* const __restrict q, const uint64_t* const __restrict qu, const uint64_t* const __restrict train, const uint64_t* const __restrict tu, const int t0, const int t1, const int min_stable, LatchKnn& k) {
+	const uint32_t* const __restrict scale = _LATCHMaskedScale().scale;
+	int j = t0;
+	const __m256i q0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(q)), q1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(q + 4));
+	const __m256i qu0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(qu)), qu1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(qu + 4));
+	for (; j + 4 <= t1; j += 4) {
+		const size_t at = static_cast<size_t>(j) << 3;
+		__m256i d0, d1, d2, d3, u0, u1, u2, u3;
+		_LATCHMaskedCountAVX2(q0, q1, qu0, qu1, train + at, tu + at, d0, u0);
+		_LATCHMaskedCountAVX2(q0, q1, qu0, qu1, train + at + 8, tu + at + 8, d1, u1);
+		_LATCHMaskedCountAVX2(q0, q1, qu0, qu1, train + at + 16, tu + at + 16, d2, u2);
+		_LATCHMaskedCountAVX2(q0, q1, qu0, qu1, train + at + 24, tu + at + 24, d3, u3);
+		// as in _LATCHKnnRowAVX2(), four trains per reduction in 16-bit fields
+		const uint64_t differ = _LATCHSumPackedAVX2(_mm256_add_epi64(_mm256_add_epi64(d0, _mm256_slli_epi64(d1, 16)), _mm256_add_epi64(_mm256_slli_epi64(d2, 32), _mm256_slli_epi64(d3, 48))));
+		const uint64_t unstable = _LATCHSumPackedAVX2(_mm256_add_epi64(_mm256_add_epi64(u0, _mm256_slli_epi64(u1, 16)), _mm256_add_epi64(_mm256_slli_epi64(u2, 32), _mm256_slli_epi64(u3, 48))));
+		for (int m = 0; m < 4; ++m) _LATCHKnnInsert(k, _LATCHMaskedDistance(static_cast<int>((differ >> (m << 4)) & 0xFFFF), 512 - static_cast<int>((unstable >> (m << 4)) & 0xFFFF), min_stable, scale), j + m);
+	}
+	for (; j < t1; ++j) _LATCHKnnInsert(k, _LATCHMaskedHamming(q, qu, train + (static_cast<size_t>(j) << 3), tu + (static_cast<size_t>(j) << 3), min_stable, scale), j);
+}
+
+// Sum of the eight qwords of s, whose 16-bit fields hold four separate counts
+LATCH_TARGET("avx512f") inline uint64_t _LATCHSumPackedAVX512(const __m512i s) {
+	return _LATCHSumPackedAVX2(_mm256_add_epi64(_mm512_maskz_extracti64x4_epi64(0xF, s, 0), _mm512_maskz_extracti64x4_epi64(0xF, s, 1)));
+}
+
+LATCH_TARGET("avx512f,avx512vpopcntdq,popcnt") inline void _LATCHKnnMaskedRowAVX512(const uint64_t* const __restrict q, const uint64_t* const __restrict qu, const uint64_t* const __restrict train, const uint64_t* const __restrict tu, const int t0, const int t1, const int min_stable, LatchKnn& k) {
+	const uint32_t* const __restrict scale = _LATCHMaskedScale().scale;
+	int j = t0;
+	const __m512i qv = _mm512_loadu_si512(q), quv = _mm512_loadu_si512(qu);
+	for (; j + 4 <= t1; j += 4) {
+		const size_t at = static_cast<size_t>(j) << 3;
+		__m512i differ = _mm512_setzero_si512(), unstable = _mm512_setzero_si512();
+		for (int m = 0; m < 4; ++m) {
+			// (maskz forms: GCC's -Wmaybe-uninitialized misfires on the unmasked ones under LTO)
+			const __m512i mask = _mm512_or_si512(quv, _mm512_loadu_si512(tu + at + 8 * m));
+			const __m512i d = _mm512_popcnt_epi64(_mm512_maskz_andnot_epi64(0xFF, mask, _mm512_xor_si512(qv, _mm512_loadu_si512(train + at + 8 * m))));
+			differ = _mm512_add_epi64(differ, _mm512_maskz_sll_epi64(0xFF, d, _mm_cvtsi32_si128(16 * m)));
+			unstable = _mm512_add_epi64(unstable, _mm512_maskz_sll_epi64(0xFF, _mm512_popcnt_epi64(mask), _mm_cvtsi32_si128(16 * m)));
+		}
+		const uint64_t pd = _LATCHSumPackedAVX512(differ), pu = _LATCHSumPackedAVX512(unstable);
+		for (int m = 0; m < 4; ++m) _LATCHKnnInsert(k, _LATCHMaskedDistance(static_cast<int>((pd >> (m << 4)) & 0xFFFF), 512 - static_cast<int>((pu >> (m << 4)) & 0xFFFF), min_stable, scale), j + m);
+	}
+	for (; j < t1; ++j) _LATCHKnnInsert(k, _LATCHMaskedHamming(q, qu, train + (static_cast<size_t>(j) << 3), tu + (static_cast<size_t>(j) << 3), min_stable, scale), j);
+}
+
+inline LatchKnnMaskedRowFn _LATCHActiveKnnMaskedRow() {
+	const _LatchCpu& cpu = _LATCHCpu();
+	const LatchKernel k = LATCHActiveKernel();
+	if (k >= LatchKernel::AVX512 && cpu.avx512vpopcntdq) return _LATCHKnnMaskedRowAVX512;
+	if (k >= LatchKernel::AVX2) return _LATCHKnnMaskedRowAVX2;
+	return _LATCHKnnMaskedRowPOPCNT;
+}
+
+// Runs row(i, t0, t1, out[i]) over every query i and train tile [t0, t1), query tiles spread over pool
+template<typename Row>
+inline void _LATCHKnnTiled(const int nq, const int nt, LatchKnn* const __restrict out, LatchPool* const pool, const Row& row) {
+	const int tiles = (nq + LATCH_MATCH_QUERY_TILE - 1) / LATCH_MATCH_QUERY_TILE;
+	std::atomic<int> next{ 0 };
+	const auto work = [&](const int) {
+		for (int tile; (tile = next.fetch_add(1, std::memory_order_relaxed)) < tiles;) {
+			const int q0 = tile * LATCH_MATCH_QUERY_TILE, q1 = std::min(nq, q0 + LATCH_MATCH_QUERY_TILE);
+			for (int i = q0; i < q1; ++i) out[i] = LatchKnn{ { -1, -1 }, { 513, 513 } };
+			for (int t0 = 0; t0 < nt; t0 += LATCH_MATCH_TRAIN_TILE) {
+				const int t1 = std::min(nt, t0 + LATCH_MATCH_TRAIN_TILE);
+				for (int i = q0; i < q1; ++i) row(i, t0, t1, out[i]);
+			}
+		}
+	};
+	if (pool) pool->run(work, std::max(1, tiles));
+	else work(0);
+}
+
+// Matches of LATCHMatch() from the forward (and, for cross_check, reverse) 2-NN
+inline std::vector<LatchMatch> _LATCHFilterMatches(const std::vector<LatchKnn>& fwd, const std::vector<LatchKnn>& rev, const float ratio, const bool cross_check) {
+	const int nq = static_cast<int>(fwd.size());
+	std::vector<LatchMatch> matches;
+	for (int i = 0; i < nq; ++i) {
+		const LatchKnn& k = fwd[i];
+		if (k.train[0] < 0) continue;
+		if (ratio < 1.0f && !(static_cast<float>(k.distance[0]) < ratio * static_cast<float>(k.distance[1]))) continue;
+		if (cross_check && rev[k.train[0]].train[0] != i) continue;
+		matches.push_back(LatchMatch{ i, k.train[0], k.distance[0] });
+	}
+	return matches;
+}
+
+// Brute-force 2-NN: for each of the nq query descriptors, the best and second best
+// of the nt train descriptors. Ties resolve to the lower train index.
+// Pass a pool (e.g. LatchExtractor::thread_pool()) to spread query tiles over its threads.
+inline void LATCHKnn(const uint64_t* const __restrict query, const int nq, const uint64_t* const __restrict train, const int nt, LatchKnn* const __restrict out, LatchPool* const pool = nullptr) {
+	const LatchKnnRowFn row = _LATCHActiveKnnRow();
+	_LATCHKnnTiled(nq, nt, out, pool, [=](const int i, const int t0, const int t1, LatchKnn& k) { row(query + (static_cast<size_t>(i) << 3), train, t0, t1, k); });
+}
+
+// Matches every query to its nearest train descriptor, keeping only those that pass
+// Lowe's ratio test (best < ratio * second best; ratio >= 1 disables the test) and,
+// if cross_check is set, whose train descriptor's own nearest query is the same query.
+inline std::vector<LatchMatch> LATCHMatch(const uint64_t* const __restrict query, const int nq, const uint64_t* const __restrict train, const int nt, const float ratio = 1.0f, const bool cross_check = false, LatchPool* const pool = nullptr) {
+	std::vector<LatchKnn> fwd(nq), rev;
+	LATCHKnn(query, nq, train, nt, fwd.data(), pool);
+	if (cross_check) {
+		rev.resize(nt);
+		LATCHKnn(train, nt, query, nq, rev.data(), pool);
+	}
+	return _LATCHFilterMatches(fwd, rev, ratio, cross_check);
+}
+
+// As LATCHKnn(), comparing only the bits stable in both descriptors of a pair, according to the
+// unstable masks query_unstable and train_unstable (laid out like the descriptors, see
+// LatchFrame::unstable). A pair's distance is the number of those bits that differ, scaled to
+// 512 bits and rounded, so it reads like a plain Hamming distance. Pairs sharing fewer than
+// min_stable stable bits are never matched.
+inline void LATCHKnnMasked(const uint64_t* const __restrict query, const uint64_t* const __restrict query_unstable, const int nq, const uint64_t* const __restrict train, const uint64_t* const __restrict train_unstable, const int nt, LatchKnn* const __restrict out, const int min_stable = 256, LatchPool* const pool = nullptr) {
+	const LatchKnnMaskedRowFn row = _LATCHActiveKnnMaskedRow();
+	_LATCHKnnTiled(nq, nt, out, pool, [=](const int i, const int t0, const int t1, LatchKnn& k) { row(query + (static_cast<size_t>(i) << 3), query_unstable + (static_cast<size_t>(i) << 3), train, train_unstable, t0, t1, min_stable, k); });
+}
+
+// LATCHMatch() on the distances of LATCHKnnMasked()
+inline std::vector<LatchMatch> LATCHMatchMasked(const uint64_t* const __restrict query, const uint64_t* const __restrict query_unstable, const int nq, const uint64_t* const __restrict train, const uint64_t* const __restrict train_unstable, const int nt, const float ratio = 1.0f, const bool cross_check = false, const int min_stable = 256, LatchPool* const pool = nullptr) {
+	std::vector<LatchKnn> fwd(nq), rev;
+	LATCHKnnMasked(query, query_unstable, nq, train, train_unstable, nt, fwd.data(), min_stable, pool);
+	if (cross_check) {
+		rev.resize(nt);
+		LATCHKnnMasked(train, train_unstable, nt, query, query_unstable, nq, rev.data(), min_stable, pool);
+	}
+	return _LATCHFilterMatches(fwd, rev, ratio, cross_check);
+}
@@ -0,0 +1,243 @@
+/*******************************************************************
+*   LATCHTrack.h
+*   LATCH
+*
+*	Author: Kareem Omar
+*	kareem.omar@uah.edu
+*	https://github.com/komrad36
+*
+*******************************************************************/
+//
+// Descriptor cache for keypoints tracked across video frames. A
+// tracker (KLT, or matching against the previous frame) passes each
+// frame's keypoints with a persistent track id. A track whose pose has
+// barely changed since its descriptor was computed gets that
+// descriptor back, and only the others are described, through the
+// extractor's pool and modes.
+//
+// A descriptor is recomputed when its keypoint has moved more than
+// position_threshold() pixels, changed scale by more than the fraction
+// scale_threshold() or turned more than angle_threshold() radians since
+// it was computed, and in any case after refresh_interval() frames, so
+// that changes in appearance (lighting, blur, occlusion) are picked up.
+// A new track's first refresh falls on a phase of the interval derived
+// from its id, so tracks born together, such as all of those of the
+// first frame, are refreshed over the interval rather than in one frame.
+//
+// Entries are kept in an open-addressed table keyed by track id, at
+// most half full. It is checked for room at the start of each frame and
+// rebuilt if needed, dropping tracks not seen for more than max_age()
+// frames, so once it has grown extract() makes no heap allocations.
+//
+
+#pragma once
+
+#include "LATCH.h"
+
+// Counts of LatchTrackCache::extract() keypoints; each falls in exactly one of the last four
+struct LatchTrackStats {
+	uint64_t keypoints = 0;
+	// descriptor returned from the cache
+	uint64_t reused = 0;
+	// described: first sighting (or first after max_age() frames)
+	uint64_t new_tracks = 0;
+	// described: pose past a threshold, or the track id repeated within the frame
+	uint64_t moved = 0;
+	// described: refresh_interval() reached
+	uint64_t refreshed = 0;
+
+	double hit_rate() const { return keypoints ? static_cast<double>(reused) / static_cast<double>(keypoints) : 0.0; }
+};
+
+class LatchTrackCache {
+public:
+	// 'extractor' (not owned) may be null for single-threaded description with the defaults
+	explicit LatchTrackCache(LatchExtractor* const extractor = nullptr) : ex(extractor) {}
+
+	// Describes the keypoints of a width x height image, keypoint i belonging to track
+	// track_ids[i], with the contract of LatchExtractor::extract(): output in keypoint order,
+	// words() uint64_t per descriptor in output_layout(), zero descriptors and valid[i] = 0
+	// for keypoints that cannot be described. Returns the number of keypoints with a
+	// descriptor, reused or computed.
+	int extract(const uint8_t* const __restrict image, const int width, const int height, const int stride, const KeyPoint* const __restrict keypoints, const uint64_t* const __restrict track_ids, const int count, uint64_t* const __restrict descriptors, uint8_t* const __restrict valid = nullptr) {
+		sync_mode();
+		++frame;
+		last = LatchTrackStats();
+		last.keypoints = static_cast<uint64_t>(std::max(0, count));
+		if (count <= 0) return 0;
+		make_room(count);
+		uint8_t* const val = valid ? valid : (flags.resize(static_cast<size_t>(count)), flags.data());
+		misses.clear();
+		slots.clear();
+		int described = 0;
+		for (int i = 0; i < count; ++i) {
+			const KeyPoint& k = keypoints[i];
+			const size_t s = find(track_ids[i]);
+			Entry& e = table[s];
+			if (!e.seen || frame - e.seen > static_cast<uint32_t>(max_age_frames)) {
+				if (!e.seen) ++used;
+				e.id = track_ids[i];
+				e.due = refresh_frames ? frame + 1 + phase(e.id) : 0;
+				++last.new_tracks;
+			}
+			else if (e.computed == frame || moved(e, k)) {
+				if (e.computed != frame) e.due = next_due();
+				++last.moved;
+			}
+			else if (e.due && frame >= e.due) {
+				e.due = next_due();
+				++last.refreshed;
+			}
+			else {
+				e.seen = frame;
+				for (int w = 0; w < words; ++w) descriptors[at(i, w)] = e.desc[w];
+				val[i] = e.valid;
+				described += e.valid;
+				++last.reused;
+				continue;
+			}
+			e.seen = e.computed = frame;
+			e.x = k.x;
+			e.y = k.y;
+			e.scale = k.scale;
+			e.angle = k.angle;
+			misses.push_back(i);
+			slots.push_back(s);
+		}
+		described += describe(image, width, height, stride, keypoints, descriptors, val);
+		for (size_t p = 0; p < misses.size(); ++p) {
+			Entry& e = table[slots[p]];
+			const int i = misses[p];
+			for (int w = 0; w < words; ++w) e.desc[w] = descriptors[at(i, w)];
+			e.valid = val[i];
+		}
+		total.keypoints += last.keypoints;
+		total.reused += last.reused;
+		total.new_tracks += last.new_tracks;
+		total.moved += last.moved;
+		total.refreshed += last.refreshed;
+		return described;
+	}
+
+	// Largest change of pose, since a track's descriptor was computed, at which it is still
+	// reused: distance in pixels (0.25 by default), relative change of scale (0.01) and
+	// angle in radians (0.005). Zero recomputes on any change.
+	void set_thresholds(const float position_px, const float scale_fraction, const float angle_radians) {
+		pos_px = std::max(0.0f, position_px);
+		scale_frac = std::max(0.0f, scale_fraction);
+		angle_rad = std::max(0.0f, angle_radians);
+	}
+	float position_threshold() const { return pos_px; }
+	float scale_threshold() const { return scale_frac; }
+	float angle_threshold() const { return angle_rad; }
+
+	// A cached descriptor is recomputed at the latest this many frames after it was computed
+	// (10 by default; 0 for never). Applies to descriptors computed from then on.
+	void set_refresh_interval(const int frames) { refresh_frames = std::max(0, frames); }
+	int refresh_interval() const { return refresh_frames; }
+
+	// A track unseen for more than this many frames is treated as new (5 by default)
+	void set_max_age(const int frames) { max_age_frames = std::max(0, frames); }
+	int max_age() const { return max_age_frames; }
+
+	// Since construction or reset_stats(), and for the last extract() call alone
+	const LatchTrackStats& stats() const { return total; }
+	const LatchTrackStats& frame_stats() const { return last; }
+	void reset_stats() { total = last = LatchTrackStats(); }
+
+	// Cached tracks, including any older than max_age() not yet dropped
+	int size() const { return static_cast<int>(used); }
+
+	// Forgets every track. Called automatically when the extractor's triplet subset, border
+	// mode or offset table changes, as those change the descriptors themselves.
+	void clear() {
+		std::fill(table.begin(), table.end(), Entry());
+		used = 0;
+	}
+
+private:
+	struct Entry {
+		uint64_t id = 0;
+		float x = 0.0f, y = 0.0f, scale = 0.0f, angle = 0.0f;
+		// frame numbers, counted from 1; seen == 0 marks an empty slot, due == 0 no refresh
+		uint32_t seen = 0, computed = 0, due = 0;
+		uint8_t valid = 0;
+		uint64_t desc[8] = {};
+	};
+
+	static uint64_t hash(const uint64_t id) { return id * 0x9E3779B97F4A7C15ull; }
+
+	uint32_t phase(const uint64_t id) const { return static_cast<uint32_t>((hash(id) >> 32) % static_cast<uint64_t>(refresh_frames)); }
+
+	uint32_t next_due() const { return refresh_frames ? frame + static_cast<uint32_t>(refresh_frames) : 0; }
+
+	size_t at(const int i, const int w) const { return mode.layout == LatchLayout::Blocked ? _LATCHBlockedIndex(i, w, words) : static_cast<size_t>(i) * words + w; }
+
+	bool moved(const Entry& e, const KeyPoint& k) const {
+		const float dx = k.x - e.x, dy = k.y - e.y;
+		return dx * dx + dy * dy > pos_px * pos_px || std::abs(k.scale - e.scale) > scale_frac * e.scale || std::abs(std::remainder(k.angle - e.angle, 6.283185307f)) > angle_rad;
+	}
+
+	// Slot holding id, or the empty slot where it belongs
+	size_t find(const uint64_t id) const {
+		const size_t mask = table.size() - 1;
+		size_t s = static_cast<size_t>(hash(id) >> shift);
+		while (table[s].seen && table[s].id != id) s = (s + 1) & mask;
+		return s;
+	}
+
+	// Ensures count more tracks fit with the table at most half full, rebuilding it without
+	// tracks older than max_age() if not. The capacity never shrinks.
+	void make_room(const int count) {
+		if ((used + static_cast<size_t>(count)) * 2 <= table.size()) return;
+		size_t live = 0;
+		for (const Entry& e : table) live += e.seen && frame - e.seen <= static_cast<uint32_t>(max_age_frames);
+		size_t cap = std::max<size_t>(64, table.size());
+		while (cap < 4 * (live + static_cast<size_t>(count))) cap <<= 1;
+		spare.assign(cap, Entry());
+		std::swap(table, spare);
+		shift = 64;
+		for (size_t c = cap; c > 1; c >>= 1) --shift;
+		used = 0;
+		for (const Entry& e : spare) {
+			if (!e.seen || frame - e.seen > static_cast<uint32_t>(max_age_frames)) continue;
+			table[find(e.id)] = e;
+			++used;
+		}
+	}
+
+	void sync_mode() {
+		_LatchMode now;
+		if (ex) {
+			now.table = ex->offset_table();
+			now.border = ex->border_mode();
+			now.subset = ex->triplet_subset();
+			now.layout = ex->output_layout();
+		}
+		if (now.table != mode.table || now.border != mode.border || now.subset != mode.subset) clear();
+		mode = now;
+		words = ex ? ex->words() : 8;
+	}
+
+	// Describes keypoints[misses], in place in the output
+	int describe(const uint8_t* const image, const int width, const int height, const int stride, const KeyPoint* const keypoints, uint64_t* const descriptors, uint8_t* const val) {
+		const int n = static_cast<int>(misses.size());
+		if (!n) return 0;
+		const LatchFrame f{ image, width, height, stride, keypoints, n, descriptors, val, nullptr, nullptr, nullptr, misses.data() };
+		return ex ? ex->extract(&f, 1) : _LATCH(f, 0, n, _LATCHActiveBits(), mode);
+	}
+
+	LatchExtractor* ex;
+	_LatchMode mode;
+	int words = 8;
+	float pos_px = 0.25f, scale_frac = 0.01f, angle_rad = 0.005f;
+	int refresh_frames = 10, max_age_frames = 5;
+	uint32_t frame = 0;
+	int shift = 64;
+	size_t used = 0;
+	std::vector<Entry> table, spare;
+	std::vector<int> misses;
+	std::vector<size_t> slots;
+	std::vector<uint8_t> flags;
+	LatchTrackStats total, last;
+};
@@ -0,0 +1,315 @@
+/*******************************************************************
+*   bench.cpp
+*   LATCH
+*
+*	Author: Kareem Omar
+*	kareem.omar@uah.edu
+*	https://github.com/komrad36
+*
+*******************************************************************/
+//
+// Benchmark suite for LATCH.h, built by 'make bench'.
+//
+// Sweeps patch kernel, thread count, image size, keypoint count and
+// keypoint scale distribution around a baseline configuration (one axis
+// at a time, except kernel x threads which is swept in full to give
+// per-core scaling efficiency; --full sweeps the whole cross product).
+// Each configuration reports median and p99 frame latency and
+// descriptors per second. The ORB detect vs. LATCH describe split is
+// measured per image size on ORB's own keypoints, next to LatchDetector
+// (LATCHDetector.h) detecting alone and fused with description.
+//
+// Usage: LATCHBench [--image=test.jpg] [--runs=50] [--warmups=10]
+//                   [--full] [--numa] [--filter=substring] [--json=out.json]
+//
+// --numa runs every extractor in NUMA mode (LatchExtractor::set_numa()).
+//
+// Benchmark names follow Google Benchmark's "name/arg:value" style, and
+// --json writes a file in the same spirit (context + benchmarks array)
+// for regression tracking.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "LATCHDetector.h"
+
+using namespace std::chrono;
+
+struct Options {
+	std::string image = "test.jpg";
+	std::string json;
+	std::string filter;
+	int runs = 50;
+	int warmups = 10;
+	bool full = false;
+	bool numa = false;
+};
+
+// Keypoint size distributions: all 31 px, the 8 levels of a 1.2x ORB pyramid, or log-uniform 8-128 px
+enum class Scales { Fixed, Pyramid, Wide };
+
+static const char* scales_name(const Scales s) {
+	switch (s) {
+	case Scales::Fixed: return "fixed";
+	case Scales::Pyramid: return "pyramid";
+	default: return "wide";
+	}
+}
+
+struct Result {
+	std::string name;
+	LatchKernel kernel;
+	int threads, keypoints, width, height;
+	Scales scales;
+	int runs;
+	double median_us, p99_us;
+	double descs_per_second;
+	// speedup over the single-threaded run of the same configuration, divided by threads; < 0 if not measured
+	double scaling_efficiency;
+};
+
+struct Timing {
+	double median_us, p99_us;
+};
+
+template<typename F>
+static Timing time_runs(const Options& opt, F&& fn) {
+	for (int i = 0; i < opt.warmups; ++i) fn();
+	std::vector<double> us(opt.runs);
+	for (auto&& t : us) {
+		const auto start = steady_clock::now();
+		fn();
+		t = duration<double, std::micro>(steady_clock::now() - start).count();
+	}
+	std::sort(us.begin(), us.end());
+	const size_t p99 = std::min(us.size() - 1, static_cast<size_t>(std::ceil(0.99 * static_cast<double>(us.size()))) - 1);
+	return Timing{ us[us.size() / 2], us[p99] };
+}
+
+// n keypoints uniformly over the described part of a w x h image, with uniform angles
+static std::vector<KeyPoint> synthetic_keypoints(const int n, const int w, const int h, const Scales scales) {
+	std::mt19937 rng(12345);
+	std::uniform_real_distribution<float> ux(37.0f, static_cast<float>(w - 37)), uy(37.0f, static_cast<float>(h - 37));
+	std::uniform_real_distribution<float> angle(0.0f, 6.2831853f), log_scale(std::log(8.0f), std::log(128.0f));
+	std::uniform_int_distribution<int> level(0, 7);
+	std::vector<KeyPoint> kps;
+	kps.reserve(n);
+	for (int i = 0; i < n; ++i) {
+		const float x = ux(rng), y = uy(rng), a = angle(rng);
+		float s = 31.0f;
+		if (scales == Scales::Pyramid) s = 31.0f * std::pow(1.2f, static_cast<float>(level(rng)));
+		else if (scales == Scales::Wide) s = std::exp(log_scale(rng));
+		kps.emplace_back(x, y, s, a);
+	}
+	return kps;
+}
+
+static std::vector<KeyPoint> from_cv(const std::vector<cv::KeyPoint>& keypoints) {
+	std::vector<KeyPoint> kps;
+	for (auto&& kp : keypoints) kps.emplace_back(kp.pt.x, kp.pt.y, kp.size, kp.angle * 3.14159265f / 180.0f);
+	return kps;
+}
+
+static std::string json_escape(const std::string& s) {
+	std::string out;
+	for (const char c : s) {
+		if (c == '"' || c == '\\') out += '\\';
+		out += c;
+	}
+	return out;
+}
+
+static bool parse_args(const int argc, char** const argv, Options& opt) {
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		const auto value = [&arg](const char* const key, std::string& out) {
+			const size_t len = std::strlen(key);
+			if (arg.compare(0, len, key)) return false;
+			out = arg.substr(len);
+			return true;
+		};
+		std::string v;
+		if (value("--image=", v)) opt.image = v;
+		else if (value("--json=", v)) opt.json = v;
+		else if (value("--filter=", v)) opt.filter = v;
+		else if (value("--runs=", v)) opt.runs = std::max(1, std::atoi(v.c_str()));
+		else if (value("--warmups=", v)) opt.warmups = std::max(0, std::atoi(v.c_str()));
+		else if (arg == "--full") opt.full = true;
+		else if (arg == "--numa") opt.numa = true;
+		else {
+			std::cerr << "Usage: " << argv[0] << " [--image=test.jpg] [--runs=50] [--warmups=10] [--full] [--numa] [--filter=substring] [--json=out.json]" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char** argv) {
+	Options opt;
+	if (!parse_args(argc, argv, opt)) return EXIT_FAILURE;
+
+	// ------------- Image Read ------------
+	cv::Mat source = cv::imread(opt.image, CV_LOAD_IMAGE_GRAYSCALE);
+	if (!source.data) {
+		std::cerr << "ERROR: failed to open image " << opt.image << ". Aborting." << std::endl;
+		return EXIT_FAILURE;
+	}
+	// --------------------------------
+
+
+	// ------------- Sweep Axes ------------
+	const int hw = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+	std::vector<LatchKernel> kernels;
+	for (int k = 0; k < static_cast<int>(LatchKernel::Count); ++k) {
+		if (LATCHKernelSupported(static_cast<LatchKernel>(k))) kernels.push_back(static_cast<LatchKernel>(k));
+	}
+	std::vector<int> thread_counts;
+	for (int t = 1; t < hw; t *= 2) thread_counts.push_back(t);
+	thread_counts.push_back(hw);
+	const std::vector<cv::Size> sizes{ cv::Size(640, 480), cv::Size(1280, 720), cv::Size(1920, 1080) };
+	const std::vector<int> counts{ 1000, 5000, 20000 };
+	const std::vector<Scales> scale_sets{ Scales::Fixed, Scales::Pyramid, Scales::Wide };
+
+	const LatchKernel base_kernel = LATCHBestKernel();
+	const int base_threads = hw, base_count = 5000;
+	const cv::Size base_size(1280, 720);
+	const Scales base_scales = Scales::Pyramid;
+	// --------------------------------
+
+
+	std::vector<cv::Mat> images(sizes.size());
+	for (size_t i = 0; i < sizes.size(); ++i) cv::resize(source, images[i], sizes[i], 0, 0, cv::INTER_AREA);
+
+	std::vector<Result> results;
+	std::cout << std::left << std::setw(80) << "Benchmark" << std::right << std::setw(12) << "Median us" << std::setw(12) << "p99 us" << std::setw(14) << "desc/s" << std::setw(10) << "Scaling" << std::endl;
+	std::cout << std::string(128, '-') << std::endl;
+
+	for (auto&& threads : thread_counts) {
+		LatchExtractor extractor(threads);
+		if (opt.numa && !extractor.set_numa(true)) {
+			std::cerr << "--numa: NUMA mode unavailable (single node, or thread pinning failed)" << std::endl;
+			return EXIT_FAILURE;
+		}
+		for (auto&& kernel : kernels) {
+			for (size_t si = 0; si < sizes.size(); ++si) {
+				for (auto&& count : counts) {
+					for (auto&& scales : scale_sets) {
+						const cv::Size sz = sizes[si];
+						// kernel x threads is the scaling sweep; every other axis varies alone
+						const int off_base = (sz.width != base_size.width || sz.height != base_size.height) + (count != base_count) + (scales != base_scales);
+						const bool scaling_row = off_base == 0;
+						const bool axis_row = off_base == 1 && kernel == base_kernel && threads == base_threads;
+						if (!opt.full && !scaling_row && !axis_row) continue;
+
+						std::ostringstream name;
+						name << "LATCH/kernel:" << LATCHKernelName(kernel) << "/threads:" << threads << (opt.numa ? "/numa" : "") << "/kps:" << count << "/size:" << sz.width << "x" << sz.height << "/scales:" << scales_name(scales);
+						if (name.str().find(opt.filter) == std::string::npos) continue;
+
+						const cv::Mat& img = images[si];
+						const std::vector<KeyPoint> kps = synthetic_keypoints(count, img.cols, img.rows, scales);
+						std::vector<uint64_t> desc(8 * kps.size());
+						LATCHSetKernel(kernel);
+						const Timing t = time_runs(opt, [&] { extractor.extract(img.data, img.cols, img.rows, static_cast<int>(img.step), kps.data(), count, desc.data()); });
+
+						double efficiency = -1.0;
+						if (threads == 1) efficiency = 1.0;
+						else {
+							for (auto&& r : results) {
+								if (r.threads == 1 && r.kernel == kernel && r.keypoints == count && r.width == sz.width && r.height == sz.height && r.scales == scales) efficiency = r.median_us / (t.median_us * threads);
+							}
+						}
+						results.push_back(Result{ name.str(), kernel, threads, count, sz.width, sz.height, scales, opt.runs, t.median_us, t.p99_us, count * 1e6 / t.median_us, efficiency });
+
+						std::cout << std::left << std::setw(80) << name.str() << std::right << std::fixed << std::setprecision(1) << std::setw(12) << t.median_us << std::setw(12) << t.p99_us << std::setprecision(0) << std::setw(14) << results.back().descs_per_second;
+						if (efficiency >= 0.0) std::cout << std::setprecision(2) << std::setw(10) << efficiency;
+						std::cout << std::endl;
+					}
+				}
+			}
+		}
+	}
+	LATCHSetKernel(LatchKernel::Auto);
+
+
+	// ------------- ORB vs. LATCH ------------
+	std::cout << std::endl << std::left << std::setw(40) << "ORB detect vs. LATCH describe" << std::right << std::setw(8) << "kps" << std::setw(14) << "detect us" << std::setw(14) << "describe us" << std::setw(12) << "LATCH %" << std::setw(16) << "LatchDet us" << std::setw(12) << "fused us" << std::endl;
+	std::cout << std::string(116, '-') << std::endl;
+	struct Split { int width, height, keypoints; double detect_us, describe_us, latch_detect_us, fused_us; };
+	std::vector<Split> splits;
+	LatchExtractor extractor(base_threads);
+	cv::Ptr<cv::ORB> orb = cv::ORB::create(base_count, 1.2f, 8, 31, 0, 2, cv::ORB::HARRIS_SCORE, 31, 20);
+	LatchDetector detector(&extractor);
+	detector.set_max_keypoints(base_count);
+	std::vector<KeyPoint> detected;
+	std::vector<uint64_t> fused_desc(8 * static_cast<size_t>(base_count));
+	for (auto&& img : images) {
+		std::vector<cv::KeyPoint> keypoints;
+		const Timing detect = time_runs(opt, [&] { keypoints.clear(); orb->detect(img, keypoints); });
+		const std::vector<KeyPoint> kps = from_cv(keypoints);
+		std::vector<uint64_t> desc(8 * kps.size() + 8);
+		const Timing describe = time_runs(opt, [&] { extractor.extract(img.data, img.cols, img.rows, static_cast<int>(img.step), kps.data(), static_cast<int>(kps.size()), desc.data()); });
+		const Timing latch_detect = time_runs(opt, [&] { detector.detect(img.data, img.cols, img.rows, static_cast<int>(img.step), detected); });
+		const Timing fused = time_runs(opt, [&] { detector.detect_and_describe(img.data, img.cols, img.rows, static_cast<int>(img.step), detected, fused_desc.data()); });
+		splits.push_back(Split{ img.cols, img.rows, static_cast<int>(kps.size()), detect.median_us, describe.median_us, latch_detect.median_us, fused.median_us });
+		std::ostringstream name;
+		name << "ORB+LATCH/size:" << img.cols << "x" << img.rows;
+		std::cout << std::left << std::setw(40) << name.str() << std::right << std::setw(8) << kps.size() << std::fixed << std::setprecision(1) << std::setw(14) << detect.median_us << std::setw(14) << describe.median_us << std::setw(12) << 100.0 * describe.median_us / (detect.median_us + describe.median_us) << std::setw(16) << latch_detect.median_us << std::setw(12) << fused.median_us << std::endl;
+	}
+	// --------------------------------
+
+
+	// ------------- JSON ------------
+	if (!opt.json.empty()) {
+		std::ofstream out(opt.json);
+		if (!out) {
+			std::cerr << "ERROR: failed to open " << opt.json << " for writing." << std::endl;
+			return EXIT_FAILURE;
+		}
+		char date[32];
+		const std::time_t now = std::time(nullptr);
+		std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+		out << std::setprecision(6) << "{\n";
+		out << "  \"context\": {\n";
+		out << "    \"date\": \"" << date << "\",\n";
+		out << "    \"num_cpus\": " << hw << ",\n";
+		out << "    \"best_kernel\": \"" << LATCHKernelName(base_kernel) << "\",\n";
+		out << "    \"image\": \"" << json_escape(opt.image) << "\",\n";
+		out << "    \"runs\": " << opt.runs << ",\n";
+		out << "    \"warmups\": " << opt.warmups << "\n";
+		out << "  },\n";
+		out << "  \"benchmarks\": [\n";
+		for (size_t i = 0; i < results.size(); ++i) {
+			const Result& r = results[i];
+			out << "    {\"name\": \"" << r.name << "\", \"kernel\": \"" << LATCHKernelName(r.kernel) << "\", \"threads\": " << r.threads << ", \"keypoints\": " << r.keypoints;
+			out << ", \"width\": " << r.width << ", \"height\": " << r.height << ", \"scales\": \"" << scales_name(r.scales) << "\", \"runs\": " << r.runs;
+			out << ", \"median_us\": " << r.median_us << ", \"p99_us\": " << r.p99_us << ", \"us_per_desc\": " << r.median_us / r.keypoints << ", \"descs_per_second\": " << r.descs_per_second;
+			out << ", \"scaling_efficiency\": ";
+			if (r.scaling_efficiency >= 0.0) out << r.scaling_efficiency;
+			else out << "null";
+			out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+		}
+		out << "  ],\n";
+		out << "  \"orb_split\": [\n";
+		for (size_t i = 0; i < splits.size(); ++i) {
+			const Split& s = splits[i];
+			out << "    {\"width\": " << s.width << ", \"height\": " << s.height << ", \"keypoints\": " << s.keypoints << ", \"detect_us\": " << s.detect_us << ", \"describe_us\": " << s.describe_us << ", \"latch_detect_us\": " << s.latch_detect_us << ", \"fused_us\": " << s.fused_us << "}" << (i + 1 < splits.size() ? "," : "") << "\n";
+		}
+		out << "  ]\n";
+		out << "}\n";
+		std::cout << std::endl << "Wrote " << opt.json << std::endl;
+	}
+	// --------------------------------
+}
@@ -0,0 +1,425 @@
+/*******************************************************************
+*   test.cpp
+*   LATCH
+*
+*	Author: Kareem Omar
+*	kareem.omar@uah.edu
+*	https://github.com/komrad36
+*
+*******************************************************************/
+//
+// Bit-exactness test for 'make test': runs LATCHVerify() on synthetic
+// images, so it needs neither OpenCV nor test.jpg. Every kernel the CPU
+// supports, in every mode, must match the scalar reference kernel bit
+// for bit on every keypoint. The images cover:
+// - the LATCH_FIXED_STRIDES strides, padded strides and odd ones;
+// - smooth, noisy, blocky and saturated textures;
+// - random keypoints, border keypoints included;
+// - a sweep of scales and angles at fractional positions.
+// The reference kernel goes through the same keypoint, offset and subset
+// code as the kernels under test, so descriptors are also checked against
+// checksums of the original implementation's output, and subsets of
+// partial bytes against full descriptors. Then LatchIndex is checked
+// against LATCHKnn(), LatchFile against what LATCHWriteFile() wrote and
+// LatchTiledDescriber against describing the whole image, and
+// LatchTrackCache is checked to forget its tracks on a new offset table.
+// Exits with failure on any mismatch.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "LATCH.h"
+#include "LATCHFile.h"
+#include "LATCHIndex.h"
+#include "LATCHTrack.h"
+
+struct TestImage {
+	const char* texture;
+	int width, height, stride;
+};
+
+// textures: "noise" (blurred noise), "gradient" (smooth ramps), "blocks" (piecewise
+// constant, many exact SSD ties), "saturated" (high contrast, mostly 0 or 255)
+static std::vector<uint8_t> make_image(const TestImage& t, const unsigned seed) {
+	std::mt19937 rng(seed);
+	const int w = t.width, h = t.height;
+	std::vector<float> f(static_cast<size_t>(w) * h);
+	for (auto& v : f) v = static_cast<float>(rng() % 256);
+	for (int pass = 0; pass < 2; ++pass) {
+		std::vector<float> g(f);
+		for (int y = 1; y < h - 1; ++y) {
+			for (int x = 1; x < w - 1; ++x) g[y * w + x] = (4.0f * f[y * w + x] + f[y * w + x - 1] + f[y * w + x + 1] + f[(y - 1) * w + x] + f[(y + 1) * w + x]) * 0.125f;
+		}
+		f.swap(g);
+	}
+	// 16 bytes of readable slack past the last row, as the kernels require
+	std::vector<uint8_t> image(static_cast<size_t>(t.stride) * h + 16, 0);
+	for (int y = 0; y < h; ++y) {
+		for (int x = 0; x < w; ++x) {
+			const float n = f[y * w + x];
+			float v;
+			if (t.texture[0] == 'g') v = 128.0f + 100.0f * std::sin(0.031f * x) * std::cos(0.017f * y) + 0.1f * (n - 128.0f);
+			else if (t.texture[0] == 'b') v = static_cast<float>(((x / 5) * 37 + (y / 7) * 91) % 256);
+			else if (t.texture[0] == 's') v = (n - 128.0f) * 12.0f + 128.0f;
+			else v = (n - 128.0f) * 3.0f + 128.0f;
+			image[static_cast<size_t>(y) * t.stride + x] = static_cast<uint8_t>(std::min(255.0f, std::max(0.0f, v)));
+		}
+	}
+	return image;
+}
+
+// Random keypoints over the whole image and a little past it, plus a sweep of 16 scales x 120
+// angles around the center at fractional offsets
+static std::vector<KeyPoint> make_keypoints(const int w, const int h, const unsigned seed) {
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> ux(-4.0f, w + 4.0f), uy(-4.0f, h + 4.0f), us(4.0f, 120.0f), ua(-6.2831853f, 12.566371f);
+	std::vector<KeyPoint> kps;
+	for (int i = 0; i < 1000; ++i) kps.emplace_back(ux(rng), uy(rng), us(rng), ua(rng));
+	for (int s = 0; s < 16; ++s) {
+		for (int a = 0; a < 360; a += 3) kps.emplace_back(0.5f * w + 0.25f * (s & 3), 0.5f * h + 0.125f * (a % 8), 4.0f + 7.5f * s, a * 3.14159265f / 180.0f);
+	}
+	return kps;
+}
+
+static const TestImage images[] = {
+	{ "noise", 640, 480, 640 },
+	{ "gradient", 1280, 720, 1280 },
+	{ "saturated", 1920, 1080, 1920 },
+	{ "blocks", 640, 360, 704 },
+	{ "noise", 333, 257, 347 },
+	{ "blocks", 1001, 601, 1003 },
+	{ "saturated", 97, 89, 97 },
+	{ "gradient", 75, 75, 80 }
+};
+
+// Every kernel and mode against the scalar reference kernel, on every image
+static int check_kernels() {
+	int failures = 0, checks = 0;
+	unsigned seed = 1;
+	for (auto&& t : images) {
+		const std::vector<uint8_t> image = make_image(t, seed++);
+		const std::vector<KeyPoint> kps = make_keypoints(t.width, t.height, seed++);
+		std::printf("%s %dx%d, stride %d, %d keypoints\n", t.texture, t.width, t.height, t.stride, static_cast<int>(kps.size()));
+		for (auto&& r : LATCHVerify(image.data(), t.width, t.height, t.stride, kps.data(), static_cast<int>(kps.size()))) {
+			++checks;
+			if (r.ok()) continue;
+			++failures;
+			std::printf("  MISMATCH %s %s: %d of %d keypoints differ, by up to %d bits:\n", LATCHKernelName(r.kernel), r.mode, r.mismatched, r.keypoints, r.max_flipped_bits);
+			for (int i = 0, shown = 0; i < r.keypoints && shown < 16; ++i) {
+				if (!r.flipped[i]) continue;
+				std::printf("    #%d (%.2f, %.2f, scale %.2f, angle %.3f): %d bits\n", i, kps[i].x, kps[i].y, kps[i].scale, kps[i].angle, r.flipped[i]);
+				++shown;
+			}
+		}
+	}
+	if (failures) std::printf("FAILED: %d of %d kernel / mode / image checks disagree with the reference.\n", failures, checks);
+	else std::printf("All %d kernel / mode / image checks match the reference bit for bit.\n", checks);
+	return failures;
+}
+
+static int report(const char* const what, const bool ok) {
+	std::printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+	return !ok;
+}
+
+// Images and keypoints for the golden checksums, from integer arithmetic and exactly
+// representable floats only, so they come out the same on every platform
+static uint32_t xorshift(uint32_t& state) {
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+// 3x3 box-blurred noise, contrast stretched
+static std::vector<uint8_t> golden_image(const int width, const int height, const int stride, uint32_t seed) {
+	std::vector<uint8_t> noise(static_cast<size_t>(width) * height), image(static_cast<size_t>(stride) * height + 16, 0);
+	for (auto& v : noise) v = static_cast<uint8_t>(xorshift(seed) >> 24);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			int sum = 0;
+			for (int dy = -1; dy <= 1; ++dy) {
+				for (int dx = -1; dx <= 1; ++dx) sum += noise[static_cast<size_t>(std::min(std::max(y + dy, 0), height - 1)) * width + std::min(std::max(x + dx, 0), width - 1)];
+			}
+			image[static_cast<size_t>(y) * stride + x] = static_cast<uint8_t>(std::min(255, std::max(0, (sum / 9 - 128) * 3 + 128)));
+		}
+	}
+	return image;
+}
+
+// Interior keypoints (strictly more than 36 px inside, which is all the original LATCH
+// describes) at 1/8 px positions, scales 4 to 128 and angles in [-2 pi, 4 pi)
+static std::vector<KeyPoint> golden_keypoints(const int width, const int height, const int count, uint32_t seed) {
+	std::vector<KeyPoint> kps;
+	for (int i = 0; i < count; ++i) {
+		const float x = 37.0f + static_cast<float>(xorshift(seed) % static_cast<uint32_t>(8 * (width - 74))) * 0.125f;
+		const float y = 37.0f + static_cast<float>(xorshift(seed) % static_cast<uint32_t>(8 * (height - 74))) * 0.125f;
+		const float scale = 4.0f + static_cast<float>(xorshift(seed) % 993) * 0.125f;
+		const float angle = static_cast<float>(static_cast<int>(xorshift(seed) % 1206) - 402) * 0.015625f;
+		kps.emplace_back(x, y, scale, angle);
+	}
+	return kps;
+}
+
+// FNV-1a over the first 'words' uint64_t of each of count descriptors of 8 words
+static uint64_t checksum(const uint64_t* const desc, const int count, const int words) {
+	uint64_t h = 0xCBF29CE484222325ull;
+	for (int i = 0; i < count; ++i) {
+		for (int w = 0; w < words; ++w) h = (h ^ desc[8 * static_cast<size_t>(i) + w]) * 0x100000001B3ull;
+	}
+	return h;
+}
+
+struct GoldenImage {
+	int width, height, stride, keypoints;
+	uint32_t seed;
+	// checksum() of the descriptors the original (pre-extension) LATCH gives, over all 8 words
+	// and over the first 4 (the 256 bits of LatchTripletSubset::first(256))
+	uint64_t full, half;
+};
+
+static const GoldenImage golden[] = {
+	{ 640, 480, 640, 3000, 11u, 0x553766221EBAE6F1ull, 0xD085102D7DA0121Bull },
+	{ 333, 257, 347, 1000, 12u, 0xB22F89FBCA248DE4ull, 0x7C5559E044832D10ull },
+	{ 1280, 720, 1280, 3000, 13u, 0xE93A59B6DB367553ull, 0x9D4760484EC68C95ull }
+};
+
+// Descriptors against checksums of the original implementation's output, so that changes to
+// the code LATCHVerify()'s reference shares with the kernels under test (keypoint loading,
+// offsets, subsets, layouts, scheduling) are caught too. Every kernel, through both LATCH()s, the
+// extractor with and without spatial sorting and border modes, the blocked layout, and a
+// 256-triplet subset.
+static int check_golden() {
+	int failures = 0;
+	for (auto&& g : golden) {
+		const std::vector<uint8_t> image = golden_image(g.width, g.height, g.stride, g.seed);
+		const std::vector<KeyPoint> kps = golden_keypoints(g.width, g.height, g.keypoints, g.seed + 100);
+		const int n = g.keypoints;
+		std::vector<uint64_t> desc(8 * static_cast<size_t>(n)), blocked(LATCHDescriptorWords(n, 8, LatchLayout::Blocked)), half(LATCHDescriptorWords(n, 4));
+		const LatchTripletSubset first256 = LatchTripletSubset::first(256);
+		LatchExtractor ex(4);
+		for (int k = 0; k < static_cast<int>(LatchKernel::Count); ++k) {
+			if (!LATCHSetKernel(static_cast<LatchKernel>(k))) continue;
+			bool ok = true;
+			std::fill(desc.begin(), desc.end(), 0);
+			LATCH<false>(image.data(), g.width, g.height, g.stride, kps.data(), n, desc.data());
+			ok &= checksum(desc.data(), n, 8) == g.full;
+			// the original's own entry point
+			std::vector<KeyPoint> erased(kps);
+			std::fill(desc.begin(), desc.end(), 0);
+			LATCH<true>(image.data(), g.width, g.height, g.stride, erased, desc.data());
+			ok &= erased.size() == kps.size() && checksum(desc.data(), n, 8) == g.full;
+			ex.set_spatial_sort(true);
+			ex.set_border_mode(LatchBorder::Reflect);
+			std::fill(desc.begin(), desc.end(), 0);
+			ex.extract(image.data(), g.width, g.height, g.stride, kps.data(), n, desc.data());
+			ok &= checksum(desc.data(), n, 8) == g.full;
+			ex.set_spatial_sort(false);
+			ex.set_border_mode(LatchBorder::Skip);
+			ex.set_output_layout(LatchLayout::Blocked);
+			ex.extract(image.data(), g.width, g.height, g.stride, kps.data(), n, blocked.data());
+			LATCHToLinear(blocked.data(), n, 8, desc.data());
+			ok &= checksum(desc.data(), n, 8) == g.full;
+			ex.set_output_layout(LatchLayout::Linear);
+			ex.set_triplet_subset(&first256);
+			ex.extract(image.data(), g.width, g.height, g.stride, kps.data(), n, half.data());
+			ex.set_triplet_subset(nullptr);
+			for (int i = 0; i < n; ++i) std::copy(half.begin() + 4 * i, half.begin() + 4 * i + 4, desc.begin() + 8 * i);
+			ok &= checksum(desc.data(), n, 4) == g.half;
+			char what[80];
+			std::snprintf(what, sizeof(what), "golden %dx%d, stride %d, %s", g.width, g.height, g.stride, LATCHKernelName(static_cast<LatchKernel>(k)));
+			failures += report(what, ok);
+		}
+		LATCHSetKernel(LatchKernel::Auto);
+	}
+	return failures;
+}
+
+// Bit j of a descriptor (or mask) of 'words' uint64_t
+static bool bit_of(const uint64_t* const d, const int j) { return (d[j >> 6] >> (j & 63)) & 1; }
+
+// Subsets of a size that is not a multiple of 8, in evaluation order and reordered: bit j of
+// the descriptor and of the unstable mask is bit j of the full ones of its triplet, and the
+// bits past size() are zero. Border keypoints take the window path.
+static int check_subsets() {
+	const TestImage t = { "noise", 640, 480, 640 };
+	const std::vector<uint8_t> image = make_image(t, 101);
+	const std::vector<KeyPoint> kps = make_keypoints(t.width, t.height, 102);
+	const int n = static_cast<int>(kps.size());
+	LatchExtractor ex(2);
+	ex.set_border_mode(LatchBorder::Replicate);
+	std::vector<uint64_t> full(8 * static_cast<size_t>(n)), full_unstable(full.size());
+	LatchFrame f{ image.data(), t.width, t.height, t.stride, kps.data(), n, full.data(), nullptr };
+	f.unstable = full_unstable.data();
+	ex.extract(&f, 1);
+	int failures = 0;
+	for (const int size : { 100, 61, 7 }) {
+		LatchTripletSet set;
+		set.assign(triplets, size);
+		const LatchTripletSubset plain = LatchTripletSubset::first(size), morton(set, true);
+		for (const LatchTripletSubset* const subset : { &plain, &morton }) {
+			const int words = subset->words();
+			std::vector<uint64_t> desc(static_cast<size_t>(words) * n), unstable(desc.size());
+			LatchFrame g = f;
+			g.descriptors = desc.data();
+			g.unstable = unstable.data();
+			ex.set_triplet_subset(subset);
+			ex.extract(&g, 1);
+			ex.set_triplet_subset(nullptr);
+			bool ok = true;
+			for (int i = 0; i < n && ok; ++i) {
+				for (int j = 0; j < 64 * words; ++j) {
+					const bool d = bit_of(desc.data() + static_cast<size_t>(i) * words, j), u = bit_of(unstable.data() + static_cast<size_t>(i) * words, j);
+					if (j < size ? d != bit_of(full.data() + 8 * static_cast<size_t>(i), j) || u != bit_of(full_unstable.data() + 8 * static_cast<size_t>(i), j) : d || u) ok = false;
+				}
+			}
+			char what[64];
+			std::snprintf(what, sizeof(what), "subset of %d triplets%s", size, subset->reordered() ? ", reordered" : "");
+			failures += report(what, ok);
+		}
+	}
+	return failures;
+}
+
+// LatchIndex against brute-force LATCHKnn(), on random descriptors queried with up to 95 bits
+// flipped, spread over the substrings as evenly as possible: the farthest the default
+// max_radius of 2 is exact for. The last descriptors are left pending.
+static int check_index() {
+	std::mt19937_64 rng(201);
+	const int n = 20000, extra = 1000, nq = 2000;
+	std::vector<uint64_t> train(8 * static_cast<size_t>(n + extra)), query(8 * static_cast<size_t>(nq));
+	for (auto& v : train) v = rng();
+	for (int i = 0; i < nq; ++i) {
+		const int j = static_cast<int>(rng() % (n + extra));
+		std::copy(train.begin() + 8 * static_cast<size_t>(j), train.begin() + 8 * static_cast<size_t>(j + 1), query.begin() + 8 * static_cast<size_t>(i));
+		// flip k goes to substring k % 32, so each substring differs in up to 3 bits
+		for (int k = static_cast<int>(rng() % 96); k-- > 0;) {
+			const int bit = 16 * (k & 31) + 5 * (k >> 5) + static_cast<int>(rng() % 5);
+			query[8 * static_cast<size_t>(i) + (bit >> 6)] ^= uint64_t(1) << (bit & 63);
+		}
+	}
+	LatchIndex index;
+	index.insert(train.data(), n);
+	index.insert(train.data() + 8 * static_cast<size_t>(n), extra);
+	std::vector<LatchKnn> brute(nq), indexed(nq);
+	LATCHKnn(query.data(), nq, train.data(), n + extra, brute.data());
+	const auto same = [&] {
+		for (int i = 0; i < nq; ++i) {
+			if (indexed[i].train[0] != brute[i].train[0] || indexed[i].distance[0] != brute[i].distance[0]) return false;
+		}
+		return true;
+	};
+	index.knn(query.data(), nq, indexed.data());
+	int failures = report("index with pending descriptors", index.pending() == extra && same());
+	index.compact();
+	index.knn(query.data(), nq, indexed.data());
+	failures += report("index, compacted", index.pending() == 0 && same());
+	return failures;
+}
+
+// LATCHWriteFile() then LatchFile::open() gives back the keypoints, descriptors and valid
+// flags, and the same file cut short by one byte is rejected
+static int check_file() {
+	const TestImage t = { "noise", 640, 480, 640 };
+	const std::vector<uint8_t> image = make_image(t, 301);
+	const std::vector<KeyPoint> kps = make_keypoints(t.width, t.height, 302);
+	const int n = static_cast<int>(kps.size());
+	std::vector<uint64_t> desc(8 * static_cast<size_t>(n));
+	std::vector<uint8_t> valid(n);
+	LATCH<false>(image.data(), t.width, t.height, t.stride, kps.data(), n, desc.data(), valid.data());
+	const char* const path = "LATCHTest.dsc";
+	LatchFile file;
+	bool ok = LATCHWriteFile(path, kps.data(), n, desc.data(), valid.data()) && file.open(path) && file.count() == n && file.words() == 8 && file.layout() == LatchLayout::Linear && file.valid();
+	for (int i = 0; i < n && ok; ++i) {
+		const KeyPoint k = file.keypoint(i);
+		ok = k.x == kps[i].x && k.y == kps[i].y && k.scale == kps[i].scale && k.angle == kps[i].angle && file.valid()[i] == valid[i];
+	}
+	ok = ok && !std::memcmp(file.descriptors(), desc.data(), desc.size() * sizeof(uint64_t));
+	int failures = report("file round trip", ok);
+	std::vector<uint8_t> bytes;
+	if (FILE* const in = std::fopen(path, "rb")) {
+		for (int c; (c = std::fgetc(in)) != EOF;) bytes.push_back(static_cast<uint8_t>(c));
+		std::fclose(in);
+	}
+	file.close();
+	ok = !bytes.empty();
+	if (FILE* const out = std::fopen(path, "wb")) {
+		ok = ok && std::fwrite(bytes.data(), 1, bytes.size() - 1, out) == bytes.size() - 1;
+		ok = std::fclose(out) == 0 && ok;
+	}
+	failures += report("truncated file rejected", ok && !file.open(path) && !file.is_open());
+	std::remove(path);
+	return failures;
+}
+
+// LatchTiledDescriber over overlapping tiles and over strips of rows, against describing the
+// whole image with LatchExtractor::extract()
+static int check_tiled() {
+	const TestImage t = { "blocks", 1001, 601, 1003 };
+	const std::vector<uint8_t> image = make_image(t, 401);
+	const std::vector<KeyPoint> kps = make_keypoints(t.width, t.height, 402);
+	const int n = static_cast<int>(kps.size());
+	LatchExtractor ex(2);
+	int failures = 0;
+	for (const LatchBorder border : { LatchBorder::Skip, LatchBorder::Replicate }) {
+		ex.set_border_mode(border);
+		std::vector<uint64_t> whole(8 * static_cast<size_t>(n)), tiled(whole.size()), rows(whole.size());
+		std::vector<uint8_t> whole_valid(n), tiled_valid(n), rows_valid(n);
+		ex.extract(image.data(), t.width, t.height, t.stride, kps.data(), n, whole.data(), whole_valid.data());
+		LatchTiledDescriber tiles(&ex);
+		tiles.begin(t.width, t.height, kps.data(), n, tiled.data(), tiled_valid.data());
+		// 256 px tiles overlapping by 2 * LATCH_TILE_HALO
+		for (int y = 0; y < t.height; y += 256 - 2 * LATCH_TILE_HALO) {
+			for (int x = 0; x < t.width; x += 256 - 2 * LATCH_TILE_HALO) {
+				const LatchTile tile = { image.data() + static_cast<size_t>(y) * t.stride + x, x, y, std::min(256, t.width - x), std::min(256, t.height - y), t.stride };
+				tiles.tile(tile);
+			}
+		}
+		LatchTiledDescriber strips(&ex);
+		strips.begin(t.width, t.height, kps.data(), n, rows.data(), rows_valid.data());
+		for (int y = 0; y < t.height; y += 50) strips.push_rows(image.data() + static_cast<size_t>(y) * t.stride, std::min(50, t.height - y), t.stride);
+		const char* const name = border == LatchBorder::Skip ? "skip" : "replicate";
+		char what[64];
+		std::snprintf(what, sizeof(what), "tiles vs extract(), %s border", name);
+		failures += report(what, tiles.remaining() == 0 && tiled == whole && tiled_valid == whole_valid);
+		std::snprintf(what, sizeof(what), "rows vs extract(), %s border", name);
+		failures += report(what, strips.remaining() == 0 && rows == whole && rows_valid == whole_valid);
+	}
+	return failures;
+}
+
+// LatchTrackCache must forget its tracks when the extractor's offset table changes, and
+// describe the next frame as extract() does with the new table
+static int check_track_cache() {
+	const TestImage t = { "noise", 640, 480, 640 };
+	const std::vector<uint8_t> image = make_image(t, 501);
+	const std::vector<KeyPoint> kps = make_keypoints(t.width, t.height, 502);
+	const int n = static_cast<int>(kps.size());
+	std::vector<uint64_t> ids(n);
+	for (int i = 0; i < n; ++i) ids[i] = static_cast<uint64_t>(i);
+	const LatchOffsetTable table(t.stride, 36, { 4.0f, 8.0f, 16.0f, 32.0f, 64.0f, 120.0f });
+	LatchExtractor ex(2);
+	LatchTrackCache cache(&ex);
+	cache.set_refresh_interval(0);
+	std::vector<uint64_t> cached(8 * static_cast<size_t>(n)), direct(cached.size());
+	cache.extract(image.data(), t.width, t.height, t.stride, kps.data(), ids.data(), n, cached.data());
+	cache.extract(image.data(), t.width, t.height, t.stride, kps.data(), ids.data(), n, cached.data());
+	int failures = report("track cache reuses", cache.frame_stats().reused == static_cast<uint64_t>(n));
+	for (const LatchOffsetTable* const offsets : { &table, static_cast<const LatchOffsetTable*>(nullptr) }) {
+		ex.set_offset_table(offsets);
+		cache.extract(image.data(), t.width, t.height, t.stride, kps.data(), ids.data(), n, cached.data());
+		ex.extract(image.data(), t.width, t.height, t.stride, kps.data(), n, direct.data());
+		failures += report(offsets ? "track cache cleared by an offset table" : "track cache cleared by removing it", cache.frame_stats().new_tracks == static_cast<uint64_t>(n) && cached == direct);
+	}
+	return failures;
+}
+
+int main() {
+	const int failures = check_kernels() + check_golden() + check_subsets() + check_index() + check_file() + check_tiled() + check_track_cache();
+	if (failures) std::printf("FAILED: %d checks.\n", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}